@@ -0,0 +1,215 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+/* <DESC>
+ * A pool of threads, each driving its own multi handle, sharing caches
+ * </DESC>
+ *
+ * A multi handle is driven by one thread at a time. To spread a large number
+ * of transfers over several cores, this example starts NUM_WORKERS threads
+ * that each run their own multi handle and event loop. The transfers to do
+ * are kept in a single queue and every worker takes a new one from it as
+ * soon as it has room for more, so a worker that runs out of work never sits
+ * idle while others still have plenty to do.
+ *
+ * All easy handles use the same share object, so the DNS cache and the TLS
+ * session cache are common to all workers. A worker that connects to a host
+ * another worker already talked to skips the name resolve and resumes the
+ * TLS session. The share uses one mutex per type of data, so for example
+ * DNS lookups in one thread never wait for TLS session cache work in
+ * another.
+ *
+ * The connection cache is NOT shared. libcurl does not support sharing it
+ * between multi handles that are used at the same time in different
+ * threads, so every multi handle keeps its own.
+ *
+ * This example uses pthreads for threads and mutexes, but should be easy to
+ * modify to use different thread/mutex system should you want to.
+ *
+ */
+
+#include <stdio.h>
+#include <pthread.h>
+#include <curl/curl.h>
+
+/*
+  URL to fetch. If you select HTTPS, you need to use a TLS backend with mutex
+  locks taken care of (OpenSSL 1.1.x, NSS, etc) or add SSL mutex callbacks!
+*/
+#define URL "http://localhost/4KB"
+
+/* number of worker threads, each with a multi handle */
+#define NUM_WORKERS 4
+
+/* the maximum number of transfers a single worker runs in parallel */
+#define MAX_PER_WORKER 50
+
+/* total number of transfers to do */
+#define NUM_TRANSFERS 10000
+
+/* one mutex per curl_lock_data type */
+static pthread_mutex_t sharelock[CURL_LOCK_DATA_LAST];
+
+/* the queue of transfers still left to do */
+static pthread_mutex_t queuelock;
+static int queued = NUM_TRANSFERS;
+
+static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *data)
+{
+  /* not interested in the downloaded bytes, return the size */
+  (void)ptr;  /* unused */
+  (void)data; /* unused */
+  return (size_t)(size * nmemb);
+}
+
+static void lock_cb(CURL *handle, curl_lock_data data,
+                    curl_lock_access access, void *userptr)
+{
+  (void)access; /* unused */
+  (void)userptr; /* unused */
+  (void)handle; /* unused */
+  pthread_mutex_lock(&sharelock[data]);
+}
+
+static void unlock_cb(CURL *handle, curl_lock_data data,
+                      void *userptr)
+{
+  (void)userptr; /* unused */
+  (void)handle;  /* unused */
+  pthread_mutex_unlock(&sharelock[data]);
+}
+
+/* take one transfer from the queue, returns 0 if there are none left */
+static int dequeue(void)
+{
+  int got = 0;
+  pthread_mutex_lock(&queuelock);
+  if(queued > 0) {
+    queued--;
+    got = 1;
+  }
+  pthread_mutex_unlock(&queuelock);
+  return got;
+}
+
+struct worker {
+  CURLSH *share;
+  int id;
+  int done; /* number of transfers this worker completed */
+};
+
+static void add_transfer(CURLM *multi, CURLSH *share)
+{
+  CURL *curl = curl_easy_init();
+  curl_easy_setopt(curl, CURLOPT_URL, URL);
+  curl_easy_setopt(curl, CURLOPT_SHARE, share);
+  curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+  curl_multi_add_handle(multi, curl);
+}
+
+static void *run_worker(void *ptr)
+{
+  struct worker *w = (struct worker *)ptr;
+  CURLM *multi = curl_multi_init();
+  int running = 0;
+  int more = 1;
+
+  do {
+    CURLMsg *msg;
+    int left;
+
+    /* fill up with new transfers from the queue while there is room */
+    while(more && (running < MAX_PER_WORKER)) {
+      more = dequeue();
+      if(more) {
+        add_transfer(multi, w->share);
+        running++;
+      }
+    }
+
+    curl_multi_perform(multi, &running);
+
+    while((msg = curl_multi_info_read(multi, &left))) {
+      if(msg->msg == CURLMSG_DONE) {
+        CURL *e = msg->easy_handle;
+        if(msg->data.result)
+          fprintf(stderr, "Worker %d transfer failed: %s\n", w->id,
+                  curl_easy_strerror(msg->data.result));
+        curl_multi_remove_handle(multi, e);
+        curl_easy_cleanup(e);
+        w->done++;
+      }
+    }
+
+    if(running)
+      curl_multi_poll(multi, NULL, 0, 1000, NULL);
+
+  } while(running || more);
+
+  curl_multi_cleanup(multi);
+  return NULL;
+}
+
+int main(void)
+{
+  pthread_t tid[NUM_WORKERS];
+  struct worker workers[NUM_WORKERS];
+  CURLSH *share;
+  int i;
+
+  /* Must initialize libcurl before any threads are started */
+  curl_global_init(CURL_GLOBAL_ALL);
+
+  for(i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    pthread_mutex_init(&sharelock[i], NULL);
+  pthread_mutex_init(&queuelock, NULL);
+
+  share = curl_share_init();
+  curl_share_setopt(share, CURLSHOPT_LOCKFUNC, lock_cb);
+  curl_share_setopt(share, CURLSHOPT_UNLOCKFUNC, unlock_cb);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+  curl_share_setopt(share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+
+  for(i = 0; i < NUM_WORKERS; i++) {
+    int error;
+    workers[i].share = share;
+    workers[i].id = i;
+    workers[i].done = 0;
+    error = pthread_create(&tid[i], NULL, run_worker, &workers[i]);
+    if(0 != error)
+      fprintf(stderr, "Couldn't run worker number %d, errno %d\n", i, error);
+  }
+
+  /* now wait for all workers to terminate */
+  for(i = 0; i < NUM_WORKERS; i++) {
+    pthread_join(tid[i], NULL);
+    fprintf(stderr, "Worker %d did %d transfers\n", i, workers[i].done);
+  }
+
+  curl_share_cleanup(share);
+
+  pthread_mutex_destroy(&queuelock);
+  for(i = 0; i < CURL_LOCK_DATA_LAST; i++)
+    pthread_mutex_destroy(&sharelock[i]);
+
+  curl_global_cleanup();
+  return 0;
+}
@@ -263,6 +263,12 @@ typedef size_t (*curl_write_callback)(char *buffer,
                                       size_t nitems,
                                       void *outstream);
 
+/* This callback returns memory to receive at most '*size' bytes of body data
+   straight into, and may lower '*size'. Returning NULL makes libcurl use its
+   own buffer instead. */
+typedef char *(*curl_recv_buffer_callback)(size_t *size,
+                                           void *userdata);
+
 /* This callback will be called when a new resolver request is made */
 typedef int (*curl_resolver_start_callback)(void *resolver_state,
                                             void *reserved, void *userdata);
@@ -833,6 +839,16 @@ typedef enum {
    if possible. The OpenSSL backend has this ability. */
 #define CURLSSLOPT_NO_PARTIALCHAIN (1<<2)
 
+/* - EARLYDATA tells libcurl to send GET and HEAD requests as TLS 1.3 early
+   data (0-RTT) when it resumes a session that allows it. The OpenSSL backend
+   has this ability. */
+#define CURLSSLOPT_EARLYDATA (1<<3)
+
+/* - KTLS tells libcurl to let the kernel do the TLS record encryption and
+   decryption (kTLS) when the TLS library and the kernel support it. The
+   OpenSSL backend has this ability. */
+#define CURLSSLOPT_KTLS (1<<4)
+
 /* The default connection attempt delay in milliseconds for happy eyeballs.
    CURLOPT_HAPPY_EYEBALLS_TIMEOUT_MS.3 and happy-eyeballs-timeout-ms.d document
    this value, keep them in sync. */
@@ -1944,6 +1960,18 @@ typedef enum {
   /* Provider for V4 signature */
   CINIT(V4_PROVIDER, STRINGPOINT, 290),
 
+  /* TLS session cache file name to read from/write to */
+  CINIT(SSL_SESSION_FILE, STRINGPOINT, 291),
+
+  /* largest amount of body data to pass to the write callback at once */
+  CINIT(MAX_WRITE_SIZE, LONG, 292),
+
+  /* Function that returns memory to receive body data into */
+  CINIT(RECV_BUFFER_FUNCTION, FUNCTIONPOINT, 293),
+
+  /* pointer to be passed to RECV_BUFFER_FUNCTION */
+  CINIT(RECV_BUFFER_DATA, OBJECTPOINT, 294),
+
   CURLOPT_LASTENTRY /* the last unused */
 } CURLoption;
 
@@ -409,6 +409,12 @@ typedef enum {
   /* maximum number of concurrent streams to support on a connection */
   CINIT(MAX_CONCURRENT_STREAMS, LONG, 16),
 
+  /* maximum size of the buffer a HTTP/2 connection reads into */
+  CINIT(MAX_HTTP2_BUFFER, LONG, 17),
+
+  /* maximum number of pushed responses to keep per connection */
+  CINIT(MAX_CACHED_PUSHES, LONG, 18),
+
   CURLMOPT_LASTENTRY /* the last unused */
 } CURLMoption;
 
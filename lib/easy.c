@@ -817,9 +817,6 @@ struct Curl_easy *curl_easy_duphandle(struct Curl_easy *data)
    * the likeliness of us forgetting to init a buffer here in the future.
    */
   outcurl->set.buffer_size = data->set.buffer_size;
-  outcurl->state.buffer = malloc(outcurl->set.buffer_size + 1);
-  if(!outcurl->state.buffer)
-    goto fail;
 
   outcurl->state.headerbuff = malloc(HEADERSIZE);
   if(!outcurl->state.headerbuff)
@@ -942,8 +939,8 @@ void curl_easy_reset(struct Curl_easy *data)
   Curl_http_auth_cleanup_digest(data);
 #endif
 
-  /* resize receive buffer */
-  if(old_buffer_size != data->set.buffer_size) {
+  /* resize receive buffer, if there is one */
+  if(data->state.buffer && (old_buffer_size != data->set.buffer_size)) {
     char *newbuff = realloc(data->state.buffer, data->set.buffer_size + 1);
     if(!newbuff) {
       DEBUGF(fprintf(stderr, "Error: realloc of buffer failed\n"));
@@ -28,6 +28,7 @@
 #include "getinfo.h"
 
 #include "vtls/vtls.h"
+#include "x509asn1.h"
 #include "connect.h" /* Curl_getconnectinfo() */
 #include "progress.h"
 
@@ -382,6 +383,12 @@ static CURLcode getinfo_slist(struct Curl_easy *data, CURLINFO info,
     *param_slistp = Curl_cookie_list(data);
     break;
   case CURLINFO_CERTINFO:
+    {
+      /* the fields are only extracted from the certificates when asked for */
+      CURLcode result = Curl_complete_certinfo(data);
+      if(result)
+        return result;
+    }
     /* Return the a pointer to the certinfo struct. Not really an slist
        pointer but we can pretend it is here */
     ptr.to_certinfo = &data->info.certs;
@@ -238,10 +238,21 @@ void Curl_hostcache_prune(struct Curl_easy *data)
 
   time(&now);
 
-  /* Remove outdated and unused entries from the hostcache */
-  hostcache_prune(data->dns.hostcache,
-                  data->set.dns_cache_timeout,
-                  now);
+  /* The entries are time stamped with one second resolution so pruning more
+     than once per second rarely finds anything more to remove. Skipping it
+     avoids walking through the entire cache, while holding the lock of a
+     possibly shared cache, for every single transfer that is done. Stale
+     entries are still never used since fetch_addr() checks them on lookup. A
+     zero timeout means no caching at all, so then always prune. */
+  if(!data->dns.hostcache_pruned || !data->set.dns_cache_timeout ||
+     (*data->dns.hostcache_pruned != now)) {
+    /* Remove outdated and unused entries from the hostcache */
+    hostcache_prune(data->dns.hostcache,
+                    data->set.dns_cache_timeout,
+                    now);
+    if(data->dns.hostcache_pruned)
+      *data->dns.hostcache_pruned = now;
+  }
 
   if(data->share)
     Curl_share_unlock(data, CURL_LOCK_DATA_DNS);
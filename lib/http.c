@@ -2484,6 +2484,9 @@ CURLcode Curl_http(struct connectdata *conn, bool *done)
           return CURLE_READ_ERROR;
         }
         /* when seekerr == CURL_SEEKFUNC_CANTSEEK (can't seek to offset) */
+        result = Curl_get_download_buffer(data);
+        if(result)
+          return result;
         do {
           size_t readthisamountnow =
             (data->state.resume_from - passed > data->set.buffer_size) ?
@@ -4033,7 +4036,7 @@ CURLcode Curl_http_readwrite_headers(struct Curl_easy *data,
                       /* If there is a custom-set Host: name, use it
                          here, or else use real peer host name. */
                       conn->allocptr.cookiehost?
-                      conn->allocptr.cookiehost:conn->host.name,
+                      conn->allocptr.cookiehost:data->state.req_host,
                       data->state.up.path,
                       (conn->handler->protocol&CURLPROTO_HTTPS)?
                       TRUE:FALSE);
@@ -4122,7 +4125,7 @@ CURLcode Curl_http_readwrite_headers(struct Curl_easy *data,
       enum alpnid id = (conn->httpversion == 20) ? ALPN_h2 : ALPN_h1;
       result = Curl_altsvc_parse(data, data->asi,
                                  &k->p[ strlen("Alt-Svc:") ],
-                                 id, conn->host.name,
+                                 id, data->state.req_host,
                                  curlx_uitous(conn->remote_port));
       if(result)
         return result;
@@ -169,9 +169,17 @@ struct HTTP {
                                   upper layer */
   Curl_send_buffer *trailer_recvbuf;
   int status_code; /* HTTP status code */
+  uint32_t error_code; /* HTTP/2 error code the stream was closed with */
   const uint8_t *pausedata; /* pointer to data received in on_data_chunk */
   size_t pauselen; /* the number of bytes left in data */
+  const uint8_t *lent; /* DATA handed out in place from the connection buffer,
+                          until the next http2_recv() call */
+  bool lend; /* on_data_chunk may hand out data in place */
   bool close_handled; /* TRUE if stream closure is handled by libcurl */
+  bool cached; /* the response came from a pushed one, see h2_push_serve() */
+  char *membuf; /* borrowed to keep data received while the transfer isn't
+                   reading, see h2_stream_membuf() */
+  size_t membufsize; /* size of 'membuf' */
 
   char **push_headers;       /* allocated array */
   size_t push_headers_used;  /* number of entries filled in */
@@ -194,10 +202,15 @@ struct HTTP {
   /*********** for HTTP/3 we store stream-local data here *************/
   int64_t stream3_id; /* stream we are interested in */
   bool firstheader;  /* FALSE until headers arrive */
-  bool firstbody;  /* FALSE until body arrives */
   bool h3req;    /* FALSE until request is issued */
   bool upload_done;
 #endif
+#ifdef USE_QUICHE
+  Curl_send_buffer *h3_recvbuf; /* response headers, HTTP/1 style */
+  size_t nread_h3_recvbuf; /* bytes of h3_recvbuf fed into upper layer */
+  bool h3_data; /* body data is waiting in quiche for this stream */
+  bool h3_fin;  /* the response is complete */
+#endif
 #ifdef USE_NGHTTP3
   size_t unacked_window;
   struct h3out *h3out; /* per-stream buffers for upload */
@@ -224,6 +237,9 @@ struct http_conn {
   Curl_send *send_underlying; /* underlying send Curl_send callback */
   Curl_recv *recv_underlying; /* underlying recv Curl_recv callback */
   char *inbuf; /* buffer to receive data from underlying socket */
+  size_t inbufsize; /* allocated size of inbuf */
+  size_t inbufwant; /* size inbuf gets before the next read */
+  bool inbuf_filled; /* the last read filled inbuf, more may be waiting */
   size_t inbuflen; /* number of bytes filled in inbuf */
   size_t nread_inbuf; /* number of bytes read from in inbuf */
   /* We need separate buffer for transmission and reception because we
@@ -242,6 +258,20 @@ struct http_conn {
   nghttp2_settings_entry local_settings[3];
   size_t local_settings_num;
   uint32_t error_code; /* HTTP/2 error code */
+
+  /* receive window auto-tuning */
+  uint32_t window;       /* receive window of the connection */
+  uint32_t stream_window; /* receive window of each stream */
+  size_t bdp_bytes;      /* DATA bytes received since the BDP ping was sent */
+  size_t bdp_rate;       /* highest rate measured so far, bytes/second */
+  size_t bdp_low;        /* samples in a row well below the window */
+  size_t bdp_low_max;    /* the largest of those */
+  struct curltime bdp_sent; /* when the outstanding BDP ping was sent */
+  bool bdp_ping;         /* TRUE while a BDP ping awaits its ACK */
+
+  /* pushed responses kept for later requests, oldest first */
+  struct h2_push *pushes;
+  size_t npushes;
 #else
   int unused; /* prevent a compiler warning */
 #endif
@@ -41,7 +41,11 @@
 #include "curl_memory.h"
 #include "memdebug.h"
 
+/* The connection buffer starts out this big. It grows while reads fill it,
+   up to CURLMOPT_MAX_HTTP2_BUFFER or H2_BUFSIZE_MAX, and is freed when the
+   connection goes idle. */
 #define H2_BUFSIZE 32768
+#define H2_BUFSIZE_MAX (512*1024)
 
 #if (NGHTTP2_VERSION_NUM < 0x010000)
 #error too old nghttp2 version, upgrade!
@@ -63,7 +67,44 @@
 #define NGHTTP2_HAS_SET_LOCAL_WINDOW_SIZE 1
 #endif
 
-#define HTTP2_HUGE_WINDOW_SIZE (1 << 30)
+/* The receive window each stream and the connection start out with. It
+   follows the bandwidth-delay product measured on the connection, between
+   H2_WINDOW_INITIAL and H2_WINDOW_MAX. The window of a single stream is in
+   addition capped at H2_STREAM_WINDOW_MAX, as that is how much data a stream
+   that is not read from can make libcurl hold. */
+#define H2_WINDOW_INITIAL (1 << 20)
+#define H2_WINDOW_MAX (32 << 20)
+#define H2_STREAM_WINDOW_MAX (8 << 20)
+
+/* this many samples in a row using less than a quarter of the window makes
+   it shrink */
+#define H2_BDP_LOW 3
+
+/* opaque data of the PING frames used to measure the bandwidth-delay
+   product, to tell them apart from the keep-alive ones */
+static const uint8_t h2_bdp_opaque[8] = { 'c', 'u', 'r', 'l', 'b', 'd', 'p' };
+
+/* A pushed response kept to serve a later request on the same connection
+   with, see CURLMOPT_MAX_CACHED_PUSHES. Bodies larger than H2_PUSH_MAXBODY
+   are not kept. */
+struct h2_push {
+  struct h2_push *next;
+  char *authority;
+  char *path;
+  int32_t stream_id;      /* the pushed stream, 0 once it is complete */
+  int status_code;        /* final status code, -1 until it arrives */
+  Curl_send_buffer *head; /* response header fields, in HTTP/1 style */
+  Curl_send_buffer *body;
+  bool headers_done;      /* the final header block has been received */
+};
+
+#define H2_PUSH_MAXBODY (1024*1024)
+
+/* Uploaded DATA frames are made to fill whole TLS records of this size, and
+   are never larger than H2_DATA_FRAME_MAX even if the peer allows it. */
+#define H2_TLS_RECORD 16384
+#define H2_FRAME_HDLEN 9
+#define H2_DATA_FRAME_MAX (4 * H2_TLS_RECORD)
 
 #ifdef DEBUG_HTTP2
 #define H2BUGF(x) x
@@ -80,6 +121,7 @@ static int h2_session_send(struct Curl_easy *data,
 static int h2_process_pending_input(struct connectdata *conn,
                                     struct http_conn *httpc,
                                     CURLcode *err);
+static void h2_push_remove(struct http_conn *httpc, struct h2_push *push);
 
 /*
  * Curl_http2_init_state() is called when the easy handle is created and
@@ -157,12 +199,75 @@ static CURLcode http2_disconnect(struct connectdata *conn,
 
   nghttp2_session_del(c->h2);
   Curl_safefree(c->inbuf);
+  while(c->pushes)
+    h2_push_remove(c, c->pushes);
 
   H2BUGF(infof(conn->data, "HTTP/2 DISCONNECT done\n"));
 
   return CURLE_OK;
 }
 
+UNITTEST void h2_inbuf_size(struct http_conn *httpc, size_t len,
+                            size_t max);
+
+/*
+ * Decide on the size of the connection buffer for the next read, after one
+ * that got 'len' bytes into it.
+ *
+ * A read that fills the buffer means more was waiting, so the buffer is made
+ * twice as big. One that uses less than a quarter of it makes it half as
+ * big. Never more than 'max' nor less than H2_BUFSIZE.
+ */
+UNITTEST void h2_inbuf_size(struct http_conn *httpc, size_t len,
+                            size_t max)
+{
+  httpc->inbuf_filled = (len == httpc->inbufsize);
+  if(httpc->inbuf_filled)
+    httpc->inbufwant = CURLMIN(httpc->inbufsize * 2, max);
+  else if((len < httpc->inbufsize / 4) && (httpc->inbufsize > H2_BUFSIZE))
+    httpc->inbufwant = httpc->inbufsize / 2;
+}
+
+/*
+ * Read once into the empty connection buffer, first resizing it to what the
+ * previous read asked for.
+ */
+static ssize_t h2_fill_inbuf(struct connectdata *conn, CURLcode *err)
+{
+  struct http_conn *httpc = &conn->proto.httpc;
+  size_t max = Curl_multi_max_http2_buffer(conn->data->multi);
+  ssize_t nread;
+
+  DEBUGASSERT(!httpc->inbuflen);
+  if(!max)
+    max = H2_BUFSIZE_MAX;
+  max = CURLMAX(max, H2_BUFSIZE);
+
+  if(!httpc->inbuf || (httpc->inbufwant != httpc->inbufsize)) {
+    size_t size = httpc->inbuf ? CURLMIN(httpc->inbufwant, max) : H2_BUFSIZE;
+    char *newbuf = malloc(size);
+    if(newbuf) {
+      free(httpc->inbuf);
+      httpc->inbuf = newbuf;
+      httpc->inbufsize = size;
+    }
+    else if(!httpc->inbuf) {
+      *err = CURLE_OUT_OF_MEMORY;
+      return -1;
+    }
+    httpc->inbufwant = httpc->inbufsize;
+  }
+
+  *err = CURLE_OK;
+  nread = ((Curl_recv *)httpc->recv_underlying)(
+    conn, FIRSTSOCKET, httpc->inbuf, httpc->inbufsize, err);
+  if(nread <= 0)
+    return nread;
+
+  h2_inbuf_size(httpc, (size_t)nread, max);
+  return nread;
+}
+
 /*
  * The server may send us data at any point (e.g. PING frames). Therefore,
  * we cannot assume that an HTTP/2 socket is dead just because it is readable.
@@ -197,10 +302,9 @@ static bool http2_connisdead(struct connectdata *conn)
       CURLcode result;
       struct http_conn *httpc = &conn->proto.httpc;
       ssize_t nread = -1;
-      if(httpc->recv_underlying)
+      if(httpc->recv_underlying && !httpc->inbuflen)
         /* if called "too early", this pointer isn't setup yet! */
-        nread = ((Curl_recv *)httpc->recv_underlying)(
-          conn, FIRSTSOCKET, httpc->inbuf, H2_BUFSIZE, &result);
+        nread = h2_fill_inbuf(conn, &result);
       if(nread != -1) {
         infof(conn->data,
               "%d bytes stray data read before trying h2 connection\n",
@@ -208,6 +312,8 @@ static bool http2_connisdead(struct connectdata *conn)
         httpc->nread_inbuf = 0;
         httpc->inbuflen = nread;
         (void)h2_process_pending_input(conn, httpc, &result);
+        if(!httpc->inbuflen)
+          Curl_safefree(httpc->inbuf);
       }
       else
         /* the read failed so let's say this is dead anyway */
@@ -270,12 +376,18 @@ void Curl_http2_setup_req(struct Curl_easy *data)
   http->nread_header_recvbuf = 0;
   http->bodystarted = FALSE;
   http->status_code = -1;
+  http->error_code = NGHTTP2_NO_ERROR;
   http->pausedata = NULL;
   http->pauselen = 0;
+  http->lent = NULL;
+  http->lend = FALSE;
   http->closed = FALSE;
   http->close_handled = FALSE;
+  http->cached = FALSE;
+  /* without a receive buffer of its own, an HTTP/2 stream borrows one when
+     data arrives for it, see h2_stream_membuf() */
   http->mem = data->state.buffer;
-  http->len = data->set.buffer_size;
+  http->len = data->state.buffer ? data->set.buffer_size : 0;
   http->memlen = 0;
 }
 
@@ -285,6 +397,8 @@ void Curl_http2_setup_conn(struct connectdata *conn)
   conn->proto.httpc.settings.max_concurrent_streams =
     DEFAULT_MAX_CONCURRENT_STREAMS;
   conn->proto.httpc.error_code = NGHTTP2_NO_ERROR;
+  conn->proto.httpc.window = H2_WINDOW_INITIAL;
+  conn->proto.httpc.stream_window = H2_WINDOW_INITIAL;
 }
 
 /*
@@ -489,6 +603,36 @@ static void drain_this(struct Curl_easy *data,
   DEBUGASSERT(httpc->drain_total >= data->state.drain);
 }
 
+/*
+ * Data arrived for a stream that has no buffer to keep it in, as its
+ * transfer isn't the one reading. Borrow one from the multi handle, it is
+ * given back once the transfer has read what is in it. Many streams that
+ * mostly wait then don't need a receive buffer each.
+ */
+static int h2_stream_membuf(struct Curl_easy *data, struct HTTP *stream)
+{
+  if(!stream->mem) {
+    stream->membufsize = data->set.buffer_size + 1;
+    stream->membuf = Curl_multi_getbuffer(data->multi, stream->membufsize);
+    if(!stream->membuf)
+      return 1;
+    stream->mem = stream->membuf;
+    stream->len = data->set.buffer_size;
+    stream->memlen = 0;
+  }
+  return 0;
+}
+
+/* give back the buffer borrowed by h2_stream_membuf() */
+static void h2_stream_membuf_done(struct Curl_easy *data,
+                                  struct HTTP *stream)
+{
+  if(stream->membuf) {
+    Curl_multi_putbuffer(data->multi, stream->membuf, stream->membufsize);
+    stream->membuf = NULL;
+  }
+}
+
 static struct Curl_easy *duphandle(struct Curl_easy *data)
 {
   struct Curl_easy *second = curl_easy_duphandle(data);
@@ -501,7 +645,10 @@ static struct Curl_easy *duphandle(struct Curl_easy *data)
     else {
       second->req.protop = http;
       http->header_recvbuf = Curl_add_buffer_init();
-      if(!http->header_recvbuf) {
+      /* the push is for the host of the stream it was promised on */
+      second->state.req_host = strdup(data->state.req_host);
+      if(!http->header_recvbuf || !second->state.req_host) {
+        Curl_add_buffer_free(&http->header_recvbuf);
         free(http);
         (void)Curl_close(&second);
       }
@@ -515,6 +662,187 @@ static struct Curl_easy *duphandle(struct Curl_easy *data)
 }
 
 
+static void free_push_headers(struct HTTP *stream)
+{
+  size_t i;
+  for(i = 0; i<stream->push_headers_used; i++)
+    free(stream->push_headers[i]);
+  free(stream->push_headers);
+  stream->push_headers = NULL;
+  stream->push_headers_used = 0;
+}
+
+static struct h2_push *h2_push_find(struct http_conn *httpc,
+                                    int32_t stream_id)
+{
+  struct h2_push *push;
+  for(push = httpc->pushes; push; push = push->next)
+    if(push->stream_id == stream_id)
+      return push;
+  return NULL;
+}
+
+static void h2_push_remove(struct http_conn *httpc, struct h2_push *push)
+{
+  struct h2_push **pp = &httpc->pushes;
+  while(*pp != push)
+    pp = &(*pp)->next;
+  *pp = push->next;
+  httpc->npushes--;
+
+  free(push->authority);
+  free(push->path);
+  Curl_add_buffer_free(&push->head);
+  Curl_add_buffer_free(&push->body);
+  free(push);
+}
+
+/* throw away a kept push, cancelling it if it is still arriving */
+static void h2_push_drop(struct http_conn *httpc, struct h2_push *push)
+{
+  if(push->stream_id)
+    (void)nghttp2_submit_rst_stream(httpc->h2, NGHTTP2_FLAG_NONE,
+                                    push->stream_id, NGHTTP2_CANCEL);
+  h2_push_remove(httpc, push);
+}
+
+/* Request header fields that make the response depend on more than the
+   authority and path. A push promised with one of them is not kept, and a
+   request that has one is not served from a kept push. */
+static const char * const h2_push_varies[] = {
+  "authorization", "cookie", "if-match", "if-modified-since",
+  "if-none-match", "if-range", "if-unmodified-since", "range", NULL
+};
+
+static bool h2_push_varies_on(const char *name, size_t namelen)
+{
+  const char * const *v;
+  for(v = h2_push_varies; *v; v++)
+    if((strlen(*v) == namelen) && strncasecompare(*v, name, namelen))
+      return TRUE;
+  return FALSE;
+}
+
+/*
+ * Accept a pushed GET response to keep for a later request of the same
+ * authority and path. The oldest kept one goes if there are too many.
+ * Returns nonzero to refuse the push.
+ */
+static int h2_push_keep(struct Curl_easy *data, struct connectdata *conn,
+                        struct HTTP *stream, int32_t promised_id)
+{
+  struct http_conn *httpc = &conn->proto.httpc;
+  const char *method = NULL;
+  const char *authority = NULL;
+  const char *path = NULL;
+  struct h2_push *push;
+  struct h2_push **tail;
+  size_t i;
+
+  /* the headers are stored as "name:value" */
+  for(i = 0; i < stream->push_headers_used; i++) {
+    const char *h = stream->push_headers[i];
+    if(!strncmp(h, ":method:", 8))
+      method = &h[8];
+    else if(!strncmp(h, ":authority:", 11))
+      authority = &h[11];
+    else if(!strncmp(h, ":path:", 6))
+      path = &h[6];
+    else {
+      const char *colon = strchr(h, ':');
+      if(colon && h2_push_varies_on(h, colon - h))
+        return 1;
+    }
+  }
+  if(!method || strcmp(method, "GET") || !authority || !path)
+    return 1;
+
+  if(httpc->npushes >= Curl_multi_max_cached_pushes(data->multi))
+    h2_push_drop(httpc, httpc->pushes);
+
+  push = calloc(1, sizeof(struct h2_push));
+  if(!push)
+    return 1;
+  push->stream_id = promised_id;
+  push->status_code = -1;
+  push->authority = strdup(authority);
+  push->path = strdup(path);
+  push->head = Curl_add_buffer_init();
+  push->body = Curl_add_buffer_init();
+
+  for(tail = &httpc->pushes; *tail; tail = &(*tail)->next)
+    ;
+  *tail = push;
+  httpc->npushes++;
+
+  if(!push->authority || !push->path || !push->head || !push->body) {
+    h2_push_remove(httpc, push);
+    return 1;
+  }
+  infof(data, "Keeping pushed response for %s%s (stream %d)\n",
+        authority, path, promised_id);
+  return 0;
+}
+
+/*
+ * If a completely received push has the same authority and path as this GET
+ * request, the response is served from it and nothing is sent. Requests with
+ * a range, conditions or credentials are always sent. The push is used up by
+ * this.
+ */
+static CURLcode h2_push_serve(struct connectdata *conn, struct HTTP *stream,
+                              const nghttp2_nv *nva, size_t nheader,
+                              size_t authority_idx, bool *served)
+{
+  struct http_conn *httpc = &conn->proto.httpc;
+  const nghttp2_nv *path = &nva[1];
+  const nghttp2_nv *authority = &nva[authority_idx];
+  struct h2_push *push;
+  CURLcode result;
+  size_t i;
+
+  *served = FALSE;
+  if((nva[0].valuelen != 3) || memcmp(nva[0].value, "GET", 3))
+    return CURLE_OK;
+  for(i = 0; i < nheader; i++)
+    if(h2_push_varies_on((const char *)nva[i].name, nva[i].namelen))
+      return CURLE_OK;
+
+  for(push = httpc->pushes; push; push = push->next) {
+    if(!push->stream_id &&
+       (strlen(push->path) == path->valuelen) &&
+       !memcmp(push->path, path->value, path->valuelen) &&
+       (strlen(push->authority) == authority->valuelen) &&
+       strncasecompare(push->authority, (const char *)authority->value,
+                       authority->valuelen))
+      break;
+  }
+  if(!push)
+    return CURLE_OK;
+
+  infof(conn->data, "Using pushed response for %s%s\n",
+        push->authority, push->path);
+
+  /* hand it out like response headers and body read off the stream */
+  result = Curl_add_buffer(&stream->header_recvbuf, push->head->buffer,
+                           push->head->size_used);
+  if(!result)
+    result = Curl_add_buffer(&stream->header_recvbuf, "\r\n", 2);
+  if(!result && push->body->size_used)
+    result = Curl_add_buffer(&stream->header_recvbuf, push->body->buffer,
+                             push->body->size_used);
+  h2_push_remove(httpc, push);
+  if(result)
+    return result;
+
+  stream->bodystarted = TRUE;
+  stream->cached = TRUE;
+  *served = TRUE;
+  drain_this(conn->data, httpc);
+  Curl_expire(conn->data, 0, EXPIRE_RUN_NOW);
+  return CURLE_OK;
+}
+
 static int push_promise(struct Curl_easy *data,
                         struct connectdata *conn,
                         const nghttp2_push_promise *frame)
@@ -528,7 +856,6 @@ static int push_promise(struct Curl_easy *data,
     struct curl_pushheaders heads;
     CURLMcode rc;
     struct http_conn *httpc;
-    size_t i;
     /* clone the parent */
     struct Curl_easy *newhandle = duphandle(data);
     if(!newhandle) {
@@ -557,11 +884,7 @@ static int push_promise(struct Curl_easy *data,
     Curl_set_in_callback(data, false);
 
     /* free the headers again */
-    for(i = 0; i<stream->push_headers_used; i++)
-      free(stream->push_headers[i]);
-    free(stream->push_headers);
-    stream->push_headers = NULL;
-    stream->push_headers_used = 0;
+    free_push_headers(stream);
 
     if(rv) {
       /* denied, kill off the new handle again */
@@ -599,6 +922,16 @@ static int push_promise(struct Curl_easy *data,
       goto fail;
     }
   }
+  else if(Curl_multi_max_cached_pushes(data->multi)) {
+    struct HTTP *stream = data->req.protop;
+    if(!stream) {
+      failf(data, "Internal NULL stream!\n");
+      rv = 1;
+      goto fail;
+    }
+    rv = h2_push_keep(data, conn, stream, frame->promised_stream_id);
+    free_push_headers(stream);
+  }
   else {
     H2BUGF(infof(data, "Got PUSH_PROMISE, ignore it!\n"));
     rv = 1;
@@ -619,6 +952,113 @@ static void multi_connchanged(struct Curl_multi *multi)
   multi->recheckstate = TRUE;
 }
 
+/*
+ * Count received DATA bytes. A PING is sent with the first DATA after the
+ * previous one got acknowledged, and everything that arrives until its ACK
+ * is one round trip's worth of data: a sample of the bandwidth-delay
+ * product.
+ */
+static void h2_bdp_recv(struct connectdata *conn, size_t len)
+{
+  struct http_conn *httpc = &conn->proto.httpc;
+
+  if(!httpc->bdp_ping) {
+    if(nghttp2_submit_ping(httpc->h2, NGHTTP2_FLAG_NONE, h2_bdp_opaque))
+      return;
+    httpc->bdp_ping = TRUE;
+    httpc->bdp_sent = Curl_now();
+    httpc->bdp_bytes = 0;
+  }
+  httpc->bdp_bytes += len;
+}
+
+UNITTEST bool h2_bdp_window(struct http_conn *httpc, size_t sample,
+                            size_t rate);
+
+/*
+ * Decide on the receive windows after a BDP sample of 'sample' bytes at
+ * 'rate' bytes/second. Returns TRUE if httpc->window changed.
+ *
+ * If the sample came close to filling the window while the rate still went
+ * up, the window is what holds the transfers back: it becomes twice the
+ * sample. After H2_BDP_LOW samples in a row that used less than a quarter of
+ * the window, it shrinks to twice the largest of them, so a connection that
+ * slowed down does not keep inviting more data than it gets read.
+ */
+UNITTEST bool h2_bdp_window(struct http_conn *httpc, size_t sample,
+                            size_t rate)
+{
+  size_t window;
+
+  if((sample >= httpc->window / 3 * 2) && (rate >= httpc->bdp_rate)) {
+    httpc->bdp_rate = rate;
+    httpc->bdp_low = 0;
+    httpc->bdp_low_max = 0;
+    window = CURLMIN(sample * 2, H2_WINDOW_MAX);
+  }
+  else if(sample < httpc->window / 4) {
+    if(sample > httpc->bdp_low_max)
+      httpc->bdp_low_max = sample;
+    if(++httpc->bdp_low < H2_BDP_LOW)
+      return FALSE;
+    window = CURLMAX(httpc->bdp_low_max * 2, H2_WINDOW_INITIAL);
+    httpc->bdp_low = 0;
+    httpc->bdp_low_max = 0;
+    /* what a larger window has to beat from now on */
+    httpc->bdp_rate = rate;
+  }
+  else {
+    httpc->bdp_low = 0;
+    httpc->bdp_low_max = 0;
+    return FALSE;
+  }
+
+  if(window == httpc->window)
+    return FALSE;
+  httpc->window = (uint32_t)window;
+  httpc->stream_window = CURLMIN(httpc->window, H2_STREAM_WINDOW_MAX);
+  return TRUE;
+}
+
+/*
+ * The BDP ping got acknowledged: resize the windows of the connection and,
+ * through SETTINGS_INITIAL_WINDOW_SIZE, of every stream if the sample says
+ * so.
+ */
+static int h2_bdp_ack(struct connectdata *conn)
+{
+  struct http_conn *httpc = &conn->proto.httpc;
+  timediff_t rtt = Curl_timediff_us(Curl_now(), httpc->bdp_sent);
+  size_t sample = httpc->bdp_bytes;
+  uint32_t stream_window = httpc->stream_window;
+  size_t rate;
+  int rv = 0;
+
+  httpc->bdp_ping = FALSE;
+  if(rtt <= 0)
+    rtt = 1;
+  rate = (size_t)((curl_off_t)sample * 1000000 / rtt);
+
+  if(!h2_bdp_window(httpc, sample, rate))
+    return 0;
+  infof(conn->data, "http2: %zu bytes in %ld us, receive window now %u, "
+        "%u per stream\n", sample, (long)rtt, httpc->window,
+        httpc->stream_window);
+
+  if(httpc->stream_window != stream_window) {
+    nghttp2_settings_entry iv;
+    iv.settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
+    iv.value = httpc->stream_window;
+    rv = nghttp2_submit_settings(httpc->h2, NGHTTP2_FLAG_NONE, &iv, 1);
+  }
+#ifdef NGHTTP2_HAS_SET_LOCAL_WINDOW_SIZE
+  if(!rv)
+    rv = nghttp2_session_set_local_window_size(httpc->h2, NGHTTP2_FLAG_NONE,
+                                               0, (int32_t)httpc->window);
+#endif
+  return nghttp2_is_fatal(rv) ? NGHTTP2_ERR_CALLBACK_FAILURE : 0;
+}
+
 static int on_frame_recv(nghttp2_session *session, const nghttp2_frame *frame,
                          void *userp)
 {
@@ -654,10 +1094,30 @@ static int on_frame_recv(nghttp2_session *session, const nghttp2_frame *frame,
         multi_connchanged(conn->data->multi);
       }
     }
+    else if(frame->hd.type == NGHTTP2_GOAWAY) {
+      /* The streams after last-stream-id were not processed and get closed
+         as refused, so that their transfers are retried on a new connection.
+         The others may still complete here, but no new ones should come. */
+      infof(conn->data, "GOAWAY received, last stream %d: %s (err %u)\n",
+            frame->goaway.last_stream_id,
+            http2_strerror(frame->goaway.error_code),
+            frame->goaway.error_code);
+      connclose(conn, "GOAWAY received");
+      multi_connchanged(conn->data->multi);
+    }
+    else if((frame->hd.type == NGHTTP2_PING) &&
+            (frame->hd.flags & NGHTTP2_FLAG_ACK) && httpc->bdp_ping &&
+            !memcmp(frame->ping.opaque_data, h2_bdp_opaque,
+                    sizeof(h2_bdp_opaque)))
+      return h2_bdp_ack(conn);
     return 0;
   }
   data_s = nghttp2_session_get_stream_user_data(session, stream_id);
   if(!data_s) {
+    struct h2_push *push = h2_push_find(httpc, stream_id);
+    if(push && (frame->hd.type == NGHTTP2_HEADERS) &&
+       (push->status_code / 100 != 1))
+      push->headers_done = TRUE;
     H2BUGF(infof(conn->data,
                  "No Curl_easy associated with stream: %x\n",
                  stream_id));
@@ -709,6 +1169,9 @@ static int on_frame_recv(nghttp2_session *session, const nghttp2_frame *frame,
     if(result)
       return NGHTTP2_ERR_CALLBACK_FAILURE;
 
+    if(h2_stream_membuf(data_s, stream))
+      return NGHTTP2_ERR_CALLBACK_FAILURE;
+
     left = stream->header_recvbuf->size_used - stream->nread_header_recvbuf;
     ncopy = CURLMIN(stream->len, left);
 
@@ -766,17 +1229,43 @@ static int on_data_chunk_recv(nghttp2_session *session, uint8_t flags,
 
   DEBUGASSERT(stream_id); /* should never be a zero stream ID here */
 
+  h2_bdp_recv(conn, len);
+
   /* get the stream from the hash based on Stream ID */
   data_s = nghttp2_session_get_stream_user_data(session, stream_id);
-  if(!data_s)
+  if(!data_s) {
+    struct h2_push *push = h2_push_find(&conn->proto.httpc, stream_id);
+    if(push) {
+      if(push->body->size_used + len > H2_PUSH_MAXBODY)
+        /* too big to keep */
+        h2_push_drop(&conn->proto.httpc, push);
+      else if(Curl_add_buffer(&push->body, data, len))
+        return NGHTTP2_ERR_CALLBACK_FAILURE;
+      return 0;
+    }
     /* Receiving a Stream ID not in the hash should not happen, this is an
        internal error more than anything else! */
     return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
 
   stream = data_s->req.protop;
   if(!stream)
     return NGHTTP2_ERR_CALLBACK_FAILURE;
 
+  if(stream->lend && (conn->data == data_s) && !stream->memlen &&
+     (len <= stream->len) && !data_s->req.header) {
+    /* Body data for the transfer that is reading: hand it out right from
+       the connection buffer instead of copying it. nghttp2 is paused so
+       that the buffer stays as it is until the next http2_recv() call. */
+    stream->lent = data;
+    stream->memlen = len;
+    conn->proto.httpc.pause_stream_id = stream_id;
+    return NGHTTP2_ERR_PAUSE;
+  }
+
+  if(h2_stream_membuf(data_s, stream))
+    return NGHTTP2_ERR_CALLBACK_FAILURE;
+
   nread = CURLMIN(stream->len, len);
   memcpy(&stream->mem[stream->memlen], data, nread);
 
@@ -835,6 +1324,13 @@ static int on_stream_close(nghttp2_session *session, int32_t stream_id,
     if(!data_s) {
       /* We could get stream ID not in the hash.  For example, if we
          decided to reject stream (e.g., PUSH_PROMISE). */
+      struct h2_push *push = h2_push_find(&conn->proto.httpc, stream_id);
+      if(push) {
+        if(error_code || !push->headers_done || (push->status_code < 200))
+          h2_push_remove(&conn->proto.httpc, push);
+        else
+          push->stream_id = 0; /* complete, ready to be used */
+      }
       return 0;
     }
     H2BUGF(infof(data_s, "on_stream_close(), %s (err %d), stream %u\n",
@@ -844,6 +1340,7 @@ static int on_stream_close(nghttp2_session *session, int32_t stream_id,
       return NGHTTP2_ERR_CALLBACK_FAILURE;
 
     stream->closed = TRUE;
+    stream->error_code = error_code;
     httpc = &conn->proto.httpc;
     drain_this(data_s, httpc);
     Curl_expire(data_s, 0, EXPIRE_RUN_NOW);
@@ -925,6 +1422,30 @@ static int decode_status_code(const uint8_t *value, size_t len)
   return res;
 }
 
+/* store a response header field of a kept push */
+static int h2_push_header(struct h2_push *push,
+                          const uint8_t *name, size_t namelen,
+                          const uint8_t *value, size_t valuelen)
+{
+  CURLcode result;
+
+  if(push->headers_done)
+    return 0; /* trailer fields are not kept */
+
+  if(namelen == sizeof(":status") - 1 &&
+     memcmp(":status", name, namelen) == 0) {
+    /* the final status replaces any informational response before it */
+    push->status_code = decode_status_code(value, valuelen);
+    push->head->size_used = 0;
+    result = Curl_add_bufferf(&push->head, "HTTP/2 %.*s \r\n",
+                              (int)valuelen, value);
+  }
+  else
+    result = Curl_add_bufferf(&push->head, "%.*s: %.*s\r\n",
+                              (int)namelen, name, (int)valuelen, value);
+  return result ? NGHTTP2_ERR_CALLBACK_FAILURE : 0;
+}
+
 /* frame->hd.type is either NGHTTP2_HEADERS or NGHTTP2_PUSH_PROMISE */
 static int on_header(nghttp2_session *session, const nghttp2_frame *frame,
                      const uint8_t *name, size_t namelen,
@@ -943,10 +1464,14 @@ static int on_header(nghttp2_session *session, const nghttp2_frame *frame,
 
   /* get the stream from the hash based on Stream ID */
   data_s = nghttp2_session_get_stream_user_data(session, stream_id);
-  if(!data_s)
+  if(!data_s) {
+    struct h2_push *push = h2_push_find(&conn->proto.httpc, stream_id);
+    if(push && (frame->hd.type == NGHTTP2_HEADERS))
+      return h2_push_header(push, name, namelen, value, valuelen);
     /* Receiving a Stream ID not in the hash should not happen, this is an
        internal error more than anything else! */
     return NGHTTP2_ERR_CALLBACK_FAILURE;
+  }
 
   stream = data_s->req.protop;
   if(!stream) {
@@ -960,15 +1485,18 @@ static int on_header(nghttp2_session *session, const nghttp2_frame *frame,
     char *h;
 
     if(!strcmp(":authority", (const char *)name)) {
-      /* pseudo headers are lower case */
+      /* pseudo headers are lower case. The connection's host name is the
+         one of the latest request on it, compare with the host of the
+         stream the push belongs to. */
       int rc = 0;
-      char *check = aprintf("%s:%d", conn->host.name, conn->remote_port);
+      const char *host = data_s->state.req_host;
+      char *check = aprintf("%s:%d", host, conn->remote_port);
       if(!check)
         /* no memory */
         return NGHTTP2_ERR_CALLBACK_FAILURE;
       if(!Curl_strcasecompare(check, (const char *)value) &&
          ((conn->remote_port != conn->given->defport) ||
-          !Curl_strcasecompare(conn->host.name, (const char *)value))) {
+          !Curl_strcasecompare(host, (const char *)value))) {
         /* This is push is not for the same authority that was asked for in
          * the URL. RFC 7540 section 8.2 says: "A client MUST treat a
          * PUSH_PROMISE for which the server is not authoritative as a stream
@@ -1138,6 +1666,33 @@ static ssize_t data_source_read_callback(nghttp2_session *session,
   return nread;
 }
 
+/*
+ * Make outgoing DATA frames as large as the windows and the peer allow, up
+ * to H2_DATA_FRAME_MAX. Frames larger than one TLS record are cut to whole
+ * records including the 9 byte frame header, so that a frame does not leave
+ * a tiny record behind it.
+ */
+static ssize_t data_source_read_length_callback(nghttp2_session *session,
+                                                uint8_t frame_type,
+                                                int32_t stream_id,
+                                                int32_t session_window,
+                                                int32_t stream_window,
+                                                uint32_t max_frame_size,
+                                                void *userp)
+{
+  ssize_t len = CURLMIN(session_window, stream_window);
+  (void)session;
+  (void)frame_type;
+  (void)stream_id;
+  (void)userp;
+
+  len = CURLMIN(len, (ssize_t)max_frame_size);
+  len = CURLMIN(len, H2_DATA_FRAME_MAX);
+  if(len >= H2_TLS_RECORD)
+    len -= (len % H2_TLS_RECORD) + H2_FRAME_HDLEN;
+  return (len > 0) ? len : 1;
+}
+
 #if defined(NGHTTP2_HAS_ERROR_CALLBACK) &&      \
   !defined(CURL_DISABLE_VERBOSE_STRINGS)
 static int error_callback(nghttp2_session *session,
@@ -1161,10 +1716,11 @@ static void populate_settings(struct connectdata *conn,
   iv[0].value = (uint32_t)Curl_multi_max_concurrent_streams(conn->data->multi);
 
   iv[1].settings_id = NGHTTP2_SETTINGS_INITIAL_WINDOW_SIZE;
-  iv[1].value = HTTP2_HUGE_WINDOW_SIZE;
+  iv[1].value = httpc->stream_window;
 
   iv[2].settings_id = NGHTTP2_SETTINGS_ENABLE_PUSH;
-  iv[2].value = conn->data->multi->push_cb != NULL;
+  iv[2].value = (conn->data->multi->push_cb != NULL) ||
+    (Curl_multi_max_cached_pushes(conn->data->multi) > 0);
 
   httpc->local_settings_num = 3;
 }
@@ -1174,6 +1730,14 @@ void Curl_http2_done(struct Curl_easy *data, bool premature)
   struct HTTP *http = data->req.protop;
   struct http_conn *httpc = &data->conn->proto.httpc;
 
+  if(http->membuf) {
+    /* received data nobody is going to read anymore */
+    http->mem = NULL;
+    http->len = 0;
+    http->memlen = 0;
+    h2_stream_membuf_done(data, http);
+  }
+
   /* there might be allocated resources done before this got the 'h2' pointer
      setup */
   if(http->header_recvbuf) {
@@ -1203,10 +1767,19 @@ void Curl_http2_done(struct Curl_easy *data, bool premature)
       httpc->pause_stream_id = 0;
     }
   }
+  else if(http->lent && (http->stream_id == httpc->pause_stream_id)) {
+    /* done before the data handed out in place was returned for */
+    http->lent = NULL;
+    httpc->pause_stream_id = 0;
+  }
 
   if(data->state.drain)
     drained_transfer(data, httpc);
 
+  if((CONN_INUSE(data->conn) <= 1) && !httpc->inbuflen)
+    /* the connection goes idle, don't keep a buffer around for it */
+    Curl_safefree(httpc->inbuf);
+
   /* -1 means unassigned and 0 means cleared */
   if(http->stream_id > 0) {
     int rv = nghttp2_session_set_stream_user_data(httpc->h2,
@@ -1232,6 +1805,8 @@ static CURLcode http2_init(struct connectdata *conn)
     conn->proto.httpc.inbuf = malloc(H2_BUFSIZE);
     if(conn->proto.httpc.inbuf == NULL)
       return CURLE_OUT_OF_MEMORY;
+    conn->proto.httpc.inbufsize = H2_BUFSIZE;
+    conn->proto.httpc.inbufwant = H2_BUFSIZE;
 
     rc = nghttp2_session_callbacks_new(&callbacks);
 
@@ -1256,6 +1831,9 @@ static CURLcode http2_init(struct connectdata *conn)
       (callbacks, on_begin_headers);
     /* nghttp2_on_header_callback */
     nghttp2_session_callbacks_set_on_header_callback(callbacks, on_header);
+    /* nghttp2_data_source_read_length_callback */
+    nghttp2_session_callbacks_set_data_source_read_length_callback
+      (callbacks, data_source_read_length_callback);
 
 #ifndef CURL_DISABLE_VERBOSE_STRINGS
     nghttp2_session_callbacks_set_error_callback(callbacks, error_callback);
@@ -1423,6 +2001,32 @@ CURLcode Curl_http2_done_sending(struct connectdata *conn)
   return result;
 }
 
+/*
+ * Called from transfer.c when the write callback paused the transfer. DATA
+ * that was handed to it in place has been copied away by then, so nghttp2
+ * goes on with the connection buffer now instead of keeping all the other
+ * streams waiting until this one gets unpaused.
+ */
+CURLcode Curl_http2_recv_paused(struct connectdata *conn)
+{
+  CURLcode result = CURLE_OK;
+
+  if((conn->handler == &Curl_handler_http2_ssl) ||
+     (conn->handler == &Curl_handler_http2)) {
+    struct http_conn *httpc = &conn->proto.httpc;
+    struct HTTP *stream = conn->data->req.protop;
+
+    if(stream && stream->lent) {
+      stream->lent = NULL;
+      if(httpc->pause_stream_id == stream->stream_id) {
+        httpc->pause_stream_id = 0;
+        (void)h2_process_pending_input(conn, httpc, &result);
+      }
+    }
+  }
+  return result;
+}
+
 static ssize_t http2_handle_stream_close(struct connectdata *conn,
                                          struct Curl_easy *data,
                                          struct HTTP *stream, CURLcode *err)
@@ -1447,7 +2051,7 @@ static ssize_t http2_handle_stream_close(struct connectdata *conn,
 
   /* Reset to FALSE to prevent infinite loop in readwrite_data function. */
   stream->closed = FALSE;
-  if(httpc->error_code == NGHTTP2_REFUSED_STREAM) {
+  if(stream->error_code == NGHTTP2_REFUSED_STREAM) {
     H2BUGF(infof(data, "REFUSED_STREAM (%d), try again on a new connection!\n",
                  stream->stream_id));
     connclose(conn, "REFUSED_STREAM"); /* don't use this anymore */
@@ -1455,10 +2059,10 @@ static ssize_t http2_handle_stream_close(struct connectdata *conn,
     *err = CURLE_RECV_ERROR; /* trigger Curl_retry_request() later */
     return -1;
   }
-  else if(httpc->error_code != NGHTTP2_NO_ERROR) {
+  else if(stream->error_code != NGHTTP2_NO_ERROR) {
     failf(data, "HTTP/2 stream %d was not closed cleanly: %s (err %u)",
-          stream->stream_id, http2_strerror(httpc->error_code),
-          httpc->error_code);
+          stream->stream_id, http2_strerror(stream->error_code),
+          stream->error_code);
     *err = CURLE_HTTP2_STREAM;
     return -1;
   }
@@ -1545,8 +2149,8 @@ static int h2_session_send(struct Curl_easy *data,
   return nghttp2_session_send(h2);
 }
 
-static ssize_t http2_recv(struct connectdata *conn, int sockindex,
-                          char *mem, size_t len, CURLcode *err)
+static ssize_t h2_stream_recv(struct connectdata *conn, int sockindex,
+                              char *mem, size_t len, CURLcode *err)
 {
   CURLcode result = CURLE_OK;
   ssize_t rv;
@@ -1574,6 +2178,22 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
   stream->upload_mem = NULL;
   stream->upload_len = 0;
 
+  if(stream->lent) {
+    /* the data handed out in place last time has been dealt with, let
+       nghttp2 go on with the rest of the connection buffer. That is done
+       even if nothing is left in there, as the END_STREAM flag of the
+       DATA frame only gets processed then. */
+    stream->lent = NULL;
+    if(httpc->pause_stream_id == stream->stream_id) {
+      httpc->pause_stream_id = 0;
+      stream->mem = mem;
+      stream->len = len;
+      stream->memlen = 0;
+      if(h2_process_pending_input(conn, httpc, err) != 0)
+        return -1;
+    }
+  }
+
   /*
    * At this point 'stream' is just in the Curl_easy the connection
    * identifies as its owner at this time.
@@ -1594,6 +2214,14 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
     return ncopy;
   }
 
+  if(stream->cached) {
+    /* the whole pushed response has been returned, that's the end */
+    drained_transfer(data, httpc);
+    stream->close_handled = TRUE;
+    *err = CURLE_OK;
+    return 0;
+  }
+
   H2BUGF(infof(data, "http2_recv: easy %p (stream %u)\n",
                data, stream->stream_id));
 
@@ -1677,8 +2305,7 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
     stream->memlen = 0;
 
     if(httpc->inbuflen == 0) {
-      nread = ((Curl_recv *)httpc->recv_underlying)(
-          conn, FIRSTSOCKET, httpc->inbuf, H2_BUFSIZE, &result);
+      nread = h2_fill_inbuf(conn, &result);
 
       if(nread == -1) {
         if(result != CURLE_AGAIN)
@@ -1693,6 +2320,9 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
 
       if(nread == 0) {
         H2BUGF(infof(data, "end of stream\n"));
+        if(stream->closed)
+          /* like a server closing the connection after GOAWAY */
+          return http2_handle_stream_close(conn, data, stream, err);
         *err = CURLE_OK;
         return 0;
       }
@@ -1709,7 +2339,9 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
       H2BUGF(infof(data, "Use data left in connection buffer, nread=%zd\n",
                    nread));
     }
+    stream->lend = TRUE;
     rv = nghttp2_session_mem_recv(httpc->h2, (const uint8_t *)inbuf, nread);
+    stream->lend = FALSE;
 
     if(nghttp2_is_fatal((int)rv)) {
       failf(data, "nghttp2_session_mem_recv() returned %zd:%s\n",
@@ -1742,6 +2374,14 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
       return -1;
     }
   }
+  if(stream->lent) {
+    ssize_t retlen = stream->memlen;
+    H2BUGF(infof(data, "http2_recv: lends %zd bytes for stream %u\n",
+                 retlen, stream->stream_id));
+    stream->memlen = 0;
+    data->req.recvbuf = (char *)stream->lent;
+    return retlen;
+  }
   if(stream->memlen) {
     ssize_t retlen = stream->memlen;
     H2BUGF(infof(data, "http2_recv: returns %zd for stream %u\n",
@@ -1767,12 +2407,37 @@ static ssize_t http2_recv(struct connectdata *conn, int sockindex,
      the connection */
   if(stream->closed)
     return 0;
+  if(httpc->inbuf_filled) {
+    /* the last read filled the buffer, there may be more waiting below that
+       the socket won't tell about */
+    drain_this(data, httpc);
+    Curl_expire(data, 0, EXPIRE_RUN_NOW);
+  }
   *err = CURLE_AGAIN;
   H2BUGF(infof(data, "http2_recv returns AGAIN for stream %u\n",
                stream->stream_id));
   return -1;
 }
 
+static ssize_t http2_recv(struct connectdata *conn, int sockindex,
+                          char *mem, size_t len, CURLcode *err)
+{
+  struct Curl_easy *data = conn->data;
+  struct HTTP *stream = data->req.protop;
+  ssize_t nread = h2_stream_recv(conn, sockindex, mem, len, err);
+
+  /* 'mem' may be lent for this call only, data arriving for the stream
+     after it is kept in a buffer of the stream's own */
+  if((stream->mem == mem) && !stream->memlen) {
+    stream->mem = NULL;
+    stream->len = 0;
+  }
+  if(stream->mem != stream->membuf)
+    /* what was kept in the borrowed buffer has been returned */
+    h2_stream_membuf_done(data, stream);
+  return nread;
+}
+
 /* Index where :authority header field will appear in request header
    field list. */
 #define AUTHORITY_DST_IDX 3
@@ -2092,6 +2757,21 @@ static ssize_t http2_send(struct connectdata *conn, int sockindex,
     }
   }
 
+  if(httpc->pushes && authority_idx) {
+    bool served;
+    CURLcode result = h2_push_serve(conn, stream, nva, nheader,
+                                    AUTHORITY_DST_IDX, &served);
+    if(result) {
+      free(nva);
+      *err = result;
+      return -1;
+    }
+    if(served) {
+      free(nva);
+      return len;
+    }
+  }
+
   h2_pri_spec(conn->data, &pri_spec);
 
   switch(conn->data->set.httpreq) {
@@ -2266,7 +2946,7 @@ CURLcode Curl_http2_switched(struct connectdata *conn,
 
 #ifdef NGHTTP2_HAS_SET_LOCAL_WINDOW_SIZE
   rv = nghttp2_session_set_local_window_size(httpc->h2, NGHTTP2_FLAG_NONE, 0,
-                                             HTTP2_HUGE_WINDOW_SIZE);
+                                             (int32_t)httpc->window);
   if(rv != 0) {
     failf(data, "nghttp2_session_set_local_window_size() failed: %s(%d)",
           nghttp2_strerror(rv), rv);
@@ -2278,10 +2958,10 @@ CURLcode Curl_http2_switched(struct connectdata *conn,
      mem is part of buffer pointed by stream->mem, and callbacks
      called by nghttp2_session_mem_recv() will write stream specific
      data into stream->mem, overwriting data already there. */
-  if(H2_BUFSIZE < nread) {
+  if(httpc->inbufsize < nread) {
     failf(data, "connection buffer size is too small to store data following "
                 "HTTP Upgrade response header: buflen=%zu, datalen=%zu",
-          H2_BUFSIZE, nread);
+          httpc->inbufsize, nread);
     return CURLE_HTTP2;
   }
 
@@ -2420,6 +3100,26 @@ bool Curl_h2_http_1_1_error(struct connectdata *conn)
   return (httpc->error_code == NGHTTP2_HTTP_1_1_REQUIRED);
 }
 
+/*
+ * Returns TRUE if a new stream is better off on 'conn' than on 'than': it
+ * has fewer streams in use or, with as many streams, more room left in the
+ * connection's send window.
+ */
+bool Curl_http2_less_busy(struct connectdata *conn, struct connectdata *than)
+{
+  size_t streams = CONN_INUSE(conn);
+  size_t other = CONN_INUSE(than);
+
+  if(streams != other)
+    return (streams < other);
+
+  if(!conn->proto.httpc.h2 || !than->proto.httpc.h2)
+    return FALSE;
+
+  return (nghttp2_session_get_remote_window_size(conn->proto.httpc.h2) >
+          nghttp2_session_get_remote_window_size(than->proto.httpc.h2));
+}
+
 #else /* !USE_NGHTTP2 */
 
 /* Satisfy external references even if http2 is not compiled in. */
@@ -52,6 +52,7 @@ void Curl_http2_setup_conn(struct connectdata *conn);
 void Curl_http2_setup_req(struct Curl_easy *data);
 void Curl_http2_done(struct Curl_easy *data, bool premature);
 CURLcode Curl_http2_done_sending(struct connectdata *conn);
+CURLcode Curl_http2_recv_paused(struct connectdata *conn);
 CURLcode Curl_http2_add_child(struct Curl_easy *parent,
                               struct Curl_easy *child,
                               bool exclusive);
@@ -61,6 +62,9 @@ void Curl_http2_cleanup_dependencies(struct Curl_easy *data);
 
 /* returns true if the HTTP/2 stream error was HTTP_1_1_REQUIRED */
 bool Curl_h2_http_1_1_error(struct connectdata *conn);
+
+/* returns true if a new stream should rather go on 'conn' than on 'than' */
+bool Curl_http2_less_busy(struct connectdata *conn, struct connectdata *than);
 #else /* USE_NGHTTP2 */
 #define Curl_http2_request_upgrade(x,y) CURLE_UNSUPPORTED_PROTOCOL
 #define Curl_http2_setup(x) CURLE_UNSUPPORTED_PROTOCOL
@@ -71,10 +75,12 @@ bool Curl_h2_http_1_1_error(struct connectdata *conn);
 #define Curl_http2_init_userset(x)
 #define Curl_http2_done(x,y)
 #define Curl_http2_done_sending(x)
+#define Curl_http2_recv_paused(x) CURLE_OK
 #define Curl_http2_add_child(x, y, z)
 #define Curl_http2_remove_child(x, y)
 #define Curl_http2_cleanup_dependencies(x)
 #define Curl_h2_http_1_1_error(x) 0
+#define Curl_http2_less_busy(x,y) FALSE
 #endif
 
 #endif /* HEADER_CURL_HTTP2_H */
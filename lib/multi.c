@@ -47,6 +47,11 @@
 #include "http_proxy.h"
 #include "http2.h"
 #include "socketpair.h"
+
+#ifdef USE_EPOLL
+#include <sys/epoll.h>
+#endif
+
 /* The last 3 #include files should be in this order */
 #include "curl_printf.h"
 #include "curl_memory.h"
@@ -67,6 +72,12 @@
 
 #define CURL_MULTI_HANDLE 0x000bab1e
 
+/* an unused buffer in the pool, this struct is stored in the buffer itself */
+struct multi_buffer {
+  struct multi_buffer *next;
+  size_t size;
+};
+
 #define GOOD_MULTI_HANDLE(x) \
   ((x) && (x)->type == CURL_MULTI_HANDLE)
 
@@ -329,6 +340,66 @@ static int sh_init(struct curl_hash *hash, int hashsize)
                         sh_freeentry);
 }
 
+#ifdef USE_EPOLL
+/*
+ * multi_epoll_close() gets rid of the epoll set. If 'failed' is set, it will
+ * not be created again and curl_multi_wait() keeps using poll().
+ */
+static void multi_epoll_close(struct Curl_multi *multi, bool failed)
+{
+  if(multi->epoll_fd != CURL_SOCKET_BAD) {
+    close(multi->epoll_fd);
+    multi->epoll_fd = CURL_SOCKET_BAD;
+  }
+  multi->epoll_wakeup = FALSE;
+  if(failed)
+    multi->epoll_failed = TRUE;
+}
+
+/*
+ * multi_epoll_update() changes what the epoll set waits for on socket 's',
+ * going from the 'prev' to the 'action' CURL_POLL_* state. This is done
+ * alongside every socket callback invoke, so the epoll set always mirrors
+ * what the *socket() API would tell the application.
+ */
+static void multi_epoll_update(struct Curl_multi *multi, curl_socket_t s,
+                               unsigned int prev, unsigned int action)
+{
+  struct epoll_event ev;
+  int rc;
+
+  if((multi->epoll_fd == CURL_SOCKET_BAD) || (prev == action))
+    return;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.data.fd = s;
+
+  if(action == CURL_POLL_REMOVE) {
+    /* this fails if the socket is already closed, which is fine */
+    (void)epoll_ctl(multi->epoll_fd, EPOLL_CTL_DEL, s, &ev);
+    return;
+  }
+
+  if(action & CURL_POLL_IN)
+    ev.events |= EPOLLIN;
+  if(action & CURL_POLL_OUT)
+    ev.events |= EPOLLOUT;
+
+  rc = epoll_ctl(multi->epoll_fd, prev ? EPOLL_CTL_MOD : EPOLL_CTL_ADD, s,
+                 &ev);
+  if(rc && (errno == ENOENT))
+    /* the socket was closed and the number reused without us knowing */
+    rc = epoll_ctl(multi->epoll_fd, EPOLL_CTL_ADD, s, &ev);
+  else if(rc && (errno == EEXIST))
+    rc = epoll_ctl(multi->epoll_fd, EPOLL_CTL_MOD, s, &ev);
+
+  if(rc)
+    multi_epoll_close(multi, TRUE);
+}
+#else
+#define multi_epoll_update(x,y,z,w) Curl_nop_stmt
+#endif
+
 /*
  * multi_addmsg()
  *
@@ -383,6 +454,9 @@ struct Curl_multi *Curl_multi_handle(int hashsize, /* socket hash */
     multi->wakeup_pair[1] = CURL_SOCKET_BAD;
   }
 #endif
+#ifdef USE_EPOLL
+  multi->epoll_fd = CURL_SOCKET_BAD;
+#endif
 
   return multi;
 
@@ -443,6 +517,7 @@ CURLMcode curl_multi_add_handle(struct Curl_multi *multi,
   if(!data->dns.hostcache ||
      (data->dns.hostcachetype == HCACHE_NONE)) {
     data->dns.hostcache = &multi->hostcache;
+    data->dns.hostcache_pruned = &multi->hostcache_pruned;
     data->dns.hostcachetype = HCACHE_MULTI;
   }
 
@@ -604,7 +679,7 @@ static CURLcode multi_done(struct Curl_easy *data,
     conn->dns_entry = NULL;
   }
   Curl_hostcache_prune(data);
-  Curl_safefree(data->state.ulbuf);
+  Curl_release_upload_buffer(data);
 
   /* if the transfer was completed in a paused state there can be buffered
      data left to free */
@@ -748,6 +823,7 @@ CURLMcode curl_multi_remove_handle(struct Curl_multi *multi,
     /* stop using the multi handle's DNS cache, *after* the possible
        multi_done() call above */
     data->dns.hostcache = NULL;
+    data->dns.hostcache_pruned = NULL;
     data->dns.hostcachetype = HCACHE_NONE;
   }
 
@@ -1022,6 +1098,385 @@ CURLMcode curl_multi_fdset(struct Curl_multi *multi,
 
 #define NUM_POLLS_ON_STACK 10
 
+/*
+ * multi_store_readiness() hands the outcome of the poll done in
+ * Curl_multi_wait() down to each transfer in the PERFORM state, so that
+ * Curl_readwrite() does not have to check the very same socket(s) again.
+ * 'ufds' holds the transfers' entries in the order they were added. A
+ * transfer only gets the information when the poll covered every direction
+ * Curl_readwrite() would otherwise check by itself.
+ */
+static void multi_store_readiness(struct Curl_multi *multi,
+                                  struct pollfd *ufds)
+{
+  struct Curl_easy *data;
+  curl_socket_t sockbunch[MAX_SOCKSPEREASYHANDLE];
+  unsigned int nfds = 0;
+
+  for(data = multi->easyp; data; data = data->next) {
+    int bitmap = multi_getsock(data, sockbunch);
+    struct connectdata *conn = data->conn;
+    bool read_checked = FALSE;
+    bool write_checked = FALSE;
+    int bits = 0;
+    unsigned int i;
+
+    for(i = 0; i< MAX_SOCKSPEREASYHANDLE; i++) {
+      curl_socket_t s = CURL_SOCKET_BAD;
+
+      if(bitmap & GETSOCK_READSOCK(i)) {
+        unsigned r = ufds[nfds].revents;
+        if(conn && (sockbunch[i] == conn->sockfd)) {
+          read_checked = TRUE;
+          if(r & (POLLIN|POLLERR|POLLHUP))
+            bits |= CURL_CSELECT_IN;
+          if(r & POLLNVAL)
+            bits |= CURL_CSELECT_ERR;
+        }
+        ++nfds;
+        s = sockbunch[i];
+      }
+      if(bitmap & GETSOCK_WRITESOCK(i)) {
+        unsigned r = ufds[nfds].revents;
+        if(conn && (sockbunch[i] == conn->writesockfd)) {
+          write_checked = TRUE;
+          if(r & POLLOUT)
+            bits |= CURL_CSELECT_OUT;
+          if(r & (POLLERR|POLLHUP|POLLNVAL))
+            bits |= CURL_CSELECT_ERR;
+        }
+        ++nfds;
+        s = sockbunch[i];
+      }
+      if(s == CURL_SOCKET_BAD) {
+        break;
+      }
+    }
+
+    if(conn && (data->mstate == CURLM_STATE_PERFORM) &&
+       (read_checked ||
+        ((data->req.keepon & KEEP_RECVBITS) != KEEP_RECV)) &&
+       (write_checked ||
+        ((data->req.keepon & KEEP_SENDBITS) != KEEP_SEND))) {
+      data->state.select_bits = bits;
+      data->state.select_known = TRUE;
+    }
+  }
+}
+
+#ifdef ENABLE_WAKEUP
+/*
+ * multi_drain_wakeup() reads everything curl_multi_wakeup() has written to
+ * the wakeup socketpair.
+ */
+static void multi_drain_wakeup(struct Curl_multi *multi)
+{
+  char buf[64];
+  while(1) {
+    /* the reading socket is non-blocking, try to read
+       data from it until it receives an error (except EINTR).
+       In normal cases it will get EAGAIN or EWOULDBLOCK
+       when there is no more data, breaking the loop. */
+    if(sread(multi->wakeup_pair[0], buf, sizeof(buf)) < 0) {
+#ifndef USE_WINSOCK
+      if(EINTR == SOCKERRNO)
+        continue;
+#endif
+      break;
+    }
+  }
+}
+#endif
+
+/*
+ * multi_wait_idle() is used by curl_multi_poll() when there is no socket at
+ * all to wait for.
+ */
+static void multi_wait_idle(struct Curl_multi *multi, int timeout_ms)
+{
+  long sleep_ms = 0;
+
+  /* Avoid busy-looping when there's nothing particular to wait for */
+  if(!curl_multi_timeout(multi, &sleep_ms) && sleep_ms) {
+    if(sleep_ms > timeout_ms)
+      sleep_ms = timeout_ms;
+    /* when there are no easy handles in the multi, this holds a -1
+       timeout */
+    else if(sleep_ms < 0)
+      sleep_ms = timeout_ms;
+    Curl_wait_ms((int)sleep_ms);
+  }
+}
+
+#ifdef USE_EPOLL
+/*
+ * multi_epoll_init() makes sure there is an epoll set mirroring the socket
+ * hash, creating it and registering all sockets currently in use on the
+ * first call. The wakeup socket is in the set only while 'use_wakeup' is
+ * set. Returns TRUE if the epoll set can be used.
+ */
+static bool multi_epoll_init(struct Curl_multi *multi, bool use_wakeup)
+{
+  if(multi->epoll_fd == CURL_SOCKET_BAD) {
+    struct curl_hash_iterator iter;
+    struct curl_hash_element *he;
+    struct Curl_easy *data;
+
+    if(multi->epoll_failed)
+      return FALSE;
+
+    multi->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if(multi->epoll_fd == CURL_SOCKET_BAD) {
+      multi->epoll_failed = TRUE;
+      return FALSE;
+    }
+
+    /* sockets that already are in the hash */
+    Curl_hash_start_iterate(&multi->sockhash, &iter);
+    for(he = Curl_hash_next_element(&iter); he;
+        he = Curl_hash_next_element(&iter)) {
+      struct Curl_sh_entry *entry = (struct Curl_sh_entry *)he->ptr;
+      multi_epoll_update(multi, *(curl_socket_t *)he->key, 0, entry->action);
+    }
+
+    /* and the ones the transfers want right now */
+    for(data = multi->easyp; data; data = data->next) {
+      if(singlesocket(multi, data)) {
+        multi_epoll_close(multi, FALSE);
+        return FALSE;
+      }
+    }
+  }
+
+#ifdef ENABLE_WAKEUP
+  if((multi->wakeup_pair[0] != CURL_SOCKET_BAD) &&
+     (multi->epoll_wakeup != use_wakeup)) {
+    if(use_wakeup)
+      multi_epoll_update(multi, multi->wakeup_pair[0], 0, CURL_POLL_IN);
+    else
+      multi_epoll_update(multi, multi->wakeup_pair[0], CURL_POLL_IN,
+                         CURL_POLL_REMOVE);
+    multi->epoll_wakeup = use_wakeup;
+  }
+#else
+  (void)use_wakeup;
+#endif
+
+  return (multi->epoll_fd != CURL_SOCKET_BAD);
+}
+
+/*
+ * multi_epoll_readiness() is the epoll counterpart of
+ * multi_store_readiness(): it tells every transfer in the PERFORM state what
+ * epoll_wait() reported for its sockets.
+ */
+static void multi_epoll_readiness(struct Curl_multi *multi,
+                                  struct epoll_event *events,
+                                  int nevents)
+{
+  struct Curl_easy *data;
+  int i;
+
+  /* transfers with all the sockets Curl_readwrite() would check in the set
+     learn that nothing happened, unless an event says otherwise below */
+  for(data = multi->easyp; data; data = data->next) {
+    struct connectdata *conn = data->conn;
+    bool read_checked = ((data->req.keepon & KEEP_RECVBITS) != KEEP_RECV);
+    bool write_checked = ((data->req.keepon & KEEP_SENDBITS) != KEEP_SEND);
+    int j;
+
+    if(!conn || (data->mstate != CURLM_STATE_PERFORM))
+      continue;
+
+    for(j = 0; j < data->numsocks; j++) {
+      if((data->sockets[j] == conn->sockfd) &&
+         (data->actions[j] & CURL_POLL_IN))
+        read_checked = TRUE;
+      if((data->sockets[j] == conn->writesockfd) &&
+         (data->actions[j] & CURL_POLL_OUT))
+        write_checked = TRUE;
+    }
+    if(read_checked && write_checked) {
+      data->state.select_bits = 0;
+      data->state.select_known = TRUE;
+    }
+  }
+
+  for(i = 0; i < nevents; i++) {
+    curl_socket_t s = events[i].data.fd;
+    unsigned int ev = events[i].events;
+    struct Curl_sh_entry *entry = sh_getentry(&multi->sockhash, s);
+    struct curl_hash_iterator iter;
+    struct curl_hash_element *he;
+
+    if(!entry)
+      continue;
+
+    /* the socket can be shared by many transfers, iterate */
+    Curl_hash_start_iterate(&entry->transfers, &iter);
+    for(he = Curl_hash_next_element(&iter); he;
+        he = Curl_hash_next_element(&iter)) {
+      struct connectdata *conn;
+      data = (struct Curl_easy *)he->ptr;
+      conn = data->conn;
+
+      if(!conn || (data->mstate != CURLM_STATE_PERFORM))
+        continue;
+
+      if((s == conn->sockfd) && (ev & (EPOLLIN|EPOLLERR|EPOLLHUP)))
+        data->state.select_bits |= CURL_CSELECT_IN;
+      if((s == conn->writesockfd) && (ev & (EPOLLOUT|EPOLLERR|EPOLLHUP)))
+        data->state.select_bits |= CURL_CSELECT_OUT;
+    }
+  }
+}
+
+/*
+ * multi_epoll_wait() is what Curl_multi_wait() does when there is an epoll
+ * set. Only the extra file descriptors, if any, need a poll() of their own;
+ * the transfers' sockets are all behind the single epoll descriptor.
+ */
+static CURLMcode multi_epoll_wait(struct Curl_multi *multi,
+                                  struct curl_waitfd extra_fds[],
+                                  unsigned int extra_nfds,
+                                  int timeout_ms,
+                                  int *ret,
+                                  bool extrawait)
+{
+  struct epoll_event a_few_on_stack[NUM_POLLS_ON_STACK];
+  struct epoll_event *events = &a_few_on_stack[0];
+  unsigned int maxevents = (unsigned int)Curl_hash_count(&multi->sockhash);
+  long timeout_internal;
+  int nevents = 0;
+  int retcode = 0;
+  int i;
+  bool waited = FALSE; /* the wait worked, 'events' is all there is */
+
+  if(multi->epoll_wakeup)
+    ++maxevents;
+
+  /* If the internally desired timeout is actually shorter than requested from
+     the outside, then use the shorter time! But only if the internal timer
+     is actually larger than -1! */
+  (void)multi_timeout(multi, &timeout_internal);
+  if((timeout_internal >= 0) && (timeout_internal < (long)timeout_ms))
+    timeout_ms = (int)timeout_internal;
+
+  if(maxevents > NUM_POLLS_ON_STACK) {
+    events = malloc(maxevents * sizeof(struct epoll_event));
+    if(!events)
+      return CURLM_OUT_OF_MEMORY;
+  }
+
+  if(extra_nfds) {
+    /* poll the epoll descriptor together with the external ones */
+    struct pollfd *ufds = malloc((extra_nfds + 1) * sizeof(struct pollfd));
+    unsigned int u;
+    int pollrc;
+
+    if(!ufds) {
+      if(events != &a_few_on_stack[0])
+        free(events);
+      return CURLM_OUT_OF_MEMORY;
+    }
+
+    ufds[0].fd = multi->epoll_fd;
+    ufds[0].events = POLLIN;
+    ufds[0].revents = 0;
+    for(u = 0; u < extra_nfds; u++) {
+      ufds[u + 1].fd = extra_fds[u].fd;
+      ufds[u + 1].events = 0;
+      if(extra_fds[u].events & CURL_WAIT_POLLIN)
+        ufds[u + 1].events |= POLLIN;
+      if(extra_fds[u].events & CURL_WAIT_POLLPRI)
+        ufds[u + 1].events |= POLLPRI;
+      if(extra_fds[u].events & CURL_WAIT_POLLOUT)
+        ufds[u + 1].events |= POLLOUT;
+    }
+
+    pollrc = Curl_poll(ufds, extra_nfds + 1, timeout_ms);
+
+    if(pollrc > 0) {
+      for(u = 0; u < extra_nfds; u++) {
+        unsigned short mask = 0;
+        unsigned r = ufds[u + 1].revents;
+
+        if(r & POLLIN)
+          mask |= CURL_WAIT_POLLIN;
+        if(r & POLLOUT)
+          mask |= CURL_WAIT_POLLOUT;
+        if(r & POLLPRI)
+          mask |= CURL_WAIT_POLLPRI;
+
+        extra_fds[u].revents = mask;
+        if(mask)
+          retcode++;
+      }
+
+      if(maxevents && (ufds[0].revents & POLLIN))
+        /* collect the events without waiting again */
+        nevents = epoll_wait(multi->epoll_fd, events, (int)maxevents, 0);
+    }
+    waited = (pollrc >= 0) && (nevents >= 0);
+    free(ufds);
+  }
+  else if(maxevents) {
+    struct curltime initial_tv = {0, 0};
+    int pending_ms = timeout_ms;
+
+    if(timeout_ms > 0)
+      initial_tv = Curl_now();
+
+    while(1) {
+      nevents = epoll_wait(multi->epoll_fd, events, (int)maxevents,
+                           pending_ms);
+      if(nevents >= 0)
+        waited = TRUE;
+      if((nevents != -1) || (SOCKERRNO != EINTR))
+        break;
+      if(timeout_ms > 0) {
+        pending_ms = timeout_ms -
+          (int)Curl_timediff(Curl_now(), initial_tv);
+        if(pending_ms <= 0) {
+          nevents = 0;  /* Simulate a "call timed out" case */
+          break;
+        }
+      }
+    }
+  }
+
+  if(nevents < 0)
+    nevents = 0;
+
+  for(i = 0; i < nevents; i++) {
+#ifdef ENABLE_WAKEUP
+    if(multi->epoll_wakeup &&
+       (events[i].data.fd == multi->wakeup_pair[0])) {
+      /* do not count the wakeup socket into the returned value */
+      multi_drain_wakeup(multi);
+      continue;
+    }
+#endif
+    retcode++;
+  }
+
+  if(waited)
+    /* only a wait that worked tells what the sockets are up to */
+    multi_epoll_readiness(multi, events, nevents);
+
+  if(events != &a_few_on_stack[0])
+    free(events);
+
+  if(ret)
+    *ret = retcode;
+
+  if(extrawait && !maxevents && !extra_nfds)
+    multi_wait_idle(multi, timeout_ms);
+
+  return CURLM_OK;
+}
+#endif /* USE_EPOLL */
+
 static CURLMcode Curl_multi_wait(struct Curl_multi *multi,
                                  struct curl_waitfd extra_fds[],
                                  unsigned int extra_nfds,
@@ -1048,6 +1503,12 @@ static CURLMcode Curl_multi_wait(struct Curl_multi *multi,
   if(multi->in_callback)
     return CURLM_RECURSIVE_API_CALL;
 
+#ifdef USE_EPOLL
+  if(multi_epoll_init(multi, use_wakeup))
+    return multi_epoll_wait(multi, extra_fds, extra_nfds, timeout_ms, ret,
+                            extrawait);
+#endif
+
   /* Count up how many fds we have from the multi handle */
   data = multi->easyp;
   while(data) {
@@ -1115,12 +1576,14 @@ static CURLMcode Curl_multi_wait(struct Curl_multi *multi,
         if(bitmap & GETSOCK_READSOCK(i)) {
           ufds[nfds].fd = sockbunch[i];
           ufds[nfds].events = POLLIN;
+          ufds[nfds].revents = 0;
           ++nfds;
           s = sockbunch[i];
         }
         if(bitmap & GETSOCK_WRITESOCK(i)) {
           ufds[nfds].fd = sockbunch[i];
           ufds[nfds].events = POLLOUT;
+          ufds[nfds].revents = 0;
           ++nfds;
           s = sockbunch[i];
         }
@@ -1159,6 +1622,11 @@ static CURLMcode Curl_multi_wait(struct Curl_multi *multi,
     /* wait... */
     pollrc = Curl_poll(ufds, nfds, timeout_ms);
 
+    if(curlfds && (pollrc >= 0))
+      /* let the transfers know what the poll found out about their sockets,
+         saving them from checking again in curl_multi_perform() */
+      multi_store_readiness(multi, ufds);
+
     if(pollrc > 0) {
       retcode = pollrc;
       /* copy revents results from the poll to the curl_multi_wait poll
@@ -1181,20 +1649,7 @@ static CURLMcode Curl_multi_wait(struct Curl_multi *multi,
 #ifdef ENABLE_WAKEUP
       if(use_wakeup && multi->wakeup_pair[0] != CURL_SOCKET_BAD) {
         if(ufds[curlfds + extra_nfds].revents & POLLIN) {
-          char buf[64];
-          while(1) {
-            /* the reading socket is non-blocking, try to read
-               data from it until it receives an error (except EINTR).
-               In normal cases it will get EAGAIN or EWOULDBLOCK
-               when there is no more data, breaking the loop. */
-            if(sread(multi->wakeup_pair[0], buf, sizeof(buf)) < 0) {
-#ifndef USE_WINSOCK
-              if(EINTR == SOCKERRNO)
-                continue;
-#endif
-              break;
-            }
-          }
+          multi_drain_wakeup(multi);
           /* do not count the wakeup socket into the returned value */
           retcode--;
         }
@@ -1207,23 +1662,9 @@ static CURLMcode Curl_multi_wait(struct Curl_multi *multi,
     free(ufds);
   if(ret)
     *ret = retcode;
-  if(!extrawait || nfds)
-    /* if any socket was checked */
-    ;
-  else {
-    long sleep_ms = 0;
-
-    /* Avoid busy-looping when there's nothing particular to wait for */
-    if(!curl_multi_timeout(multi, &sleep_ms) && sleep_ms) {
-      if(sleep_ms > timeout_ms)
-        sleep_ms = timeout_ms;
-      /* when there are no easy handles in the multi, this holds a -1
-         timeout */
-      else if((sleep_ms < 0) && extrawait)
-        sleep_ms = timeout_ms;
-      Curl_wait_ms((int)sleep_ms);
-    }
-  }
+  if(extrawait && !nfds)
+    /* no socket was checked */
+    multi_wait_idle(multi, timeout_ms);
 
   return CURLM_OK;
 }
@@ -2343,6 +2784,18 @@ CURLMcode curl_multi_perform(struct Curl_multi *multi, int *running_handles)
     if(result)
       returncode = result;
 
+#ifdef USE_EPOLL
+    if((CURLM_OK >= result) && (multi->epoll_fd != CURL_SOCKET_BAD)) {
+      /* keep the epoll set used by curl_multi_wait() current */
+      result = singlesocket(multi, data);
+      if(result) {
+        /* it is out of sync now, start over on the next wait */
+        multi_epoll_close(multi, FALSE);
+        returncode = result;
+      }
+    }
+#endif
+
     data = data->next; /* operate on next handle */
   }
 
@@ -2394,6 +2847,7 @@ CURLMcode curl_multi_cleanup(struct Curl_multi *multi)
         /* clear out the usage of the shared DNS cache */
         Curl_hostcache_clean(data, data->dns.hostcache);
         data->dns.hostcache = NULL;
+        data->dns.hostcache_pruned = NULL;
         data->dns.hostcachetype = HCACHE_NONE;
       }
 
@@ -2420,9 +2874,21 @@ CURLMcode curl_multi_cleanup(struct Curl_multi *multi)
     Curl_hash_destroy(&multi->hostcache);
     Curl_psl_destroy(&multi->psl);
 
+    while(multi->buffers) {
+      struct multi_buffer *next = multi->buffers->next;
+      free(multi->buffers);
+      multi->buffers = next;
+    }
+#ifdef USE_SSL
+    Curl_ssl_free_multi_ssl_backend_data(multi->ssl_backend_data);
+#endif
+
 #ifdef ENABLE_WAKEUP
     sclose(multi->wakeup_pair[0]);
     sclose(multi->wakeup_pair[1]);
+#endif
+#ifdef USE_EPOLL
+    multi_epoll_close(multi, FALSE);
 #endif
     free(multi);
 
@@ -2570,6 +3036,8 @@ static CURLMcode singlesocket(struct Curl_multi *multi,
       multi->socket_cb(data, s, comboaction, multi->socket_userp,
                        entry->socketp);
 
+    multi_epoll_update(multi, s, entry->action, comboaction);
+
     entry->action = comboaction; /* store the current action state */
   }
 
@@ -2607,6 +3075,7 @@ static CURLMcode singlesocket(struct Curl_multi *multi,
           multi->socket_cb(data, s, CURL_POLL_REMOVE,
                            multi->socket_userp,
                            entry->socketp);
+        multi_epoll_update(multi, s, entry->action, CURL_POLL_REMOVE);
         sh_delentry(entry, &multi->sockhash, s);
       }
       else {
@@ -2656,6 +3125,7 @@ void Curl_multi_closed(struct Curl_easy *data, curl_socket_t s)
           multi->socket_cb(data, s, CURL_POLL_REMOVE,
                            multi->socket_userp,
                            entry->socketp);
+        multi_epoll_update(multi, s, entry->action, CURL_POLL_REMOVE);
 
         /* now remove it from the socket hash */
         sh_delentry(entry, &multi->sockhash, s);
@@ -2772,7 +3242,7 @@ static CURLMcode multi_socket(struct Curl_multi *multi,
 
         if(data->conn && !(data->conn->handler->flags & PROTOPT_DIRLOCK))
           /* set socket event bitmask if they're not locked */
-          data->conn->cselect_bits = ev_bitmask;
+          data->state.select_bits = ev_bitmask;
 
         Curl_expire(data, 0, EXPIRE_RUN_NOW);
       }
@@ -2901,6 +3371,18 @@ CURLMcode curl_multi_setopt(struct Curl_multi *multi,
           (long)INITIAL_MAX_CONCURRENT_STREAMS : streams;
     }
     break;
+  case CURLMOPT_MAX_HTTP2_BUFFER:
+    {
+      long size = va_arg(param, long);
+      multi->max_http2_buffer = (size > 0) ? size : 0;
+    }
+    break;
+  case CURLMOPT_MAX_CACHED_PUSHES:
+    {
+      long pushes = va_arg(param, long);
+      multi->max_cached_pushes = (pushes > 0) ? pushes : 0;
+    }
+    break;
   default:
     res = CURLM_UNKNOWN_OPTION;
     break;
@@ -3345,3 +3827,61 @@ size_t Curl_multi_max_concurrent_streams(struct Curl_multi *multi)
   return multi ? ((size_t)multi->max_concurrent_streams ?
                   (size_t)multi->max_concurrent_streams : 100) : 0;
 }
+
+size_t Curl_multi_max_http2_buffer(struct Curl_multi *multi)
+{
+  return multi ? (size_t)multi->max_http2_buffer : 0;
+}
+
+size_t Curl_multi_max_cached_pushes(struct Curl_multi *multi)
+{
+  return multi ? (size_t)multi->max_cached_pushes : 0;
+}
+
+/*
+ * Curl_multi_getbuffer() lends a buffer of 'size' bytes to a transfer. An
+ * unused one of the same size is taken from the pool of the multi handle
+ * when there is one, so that a large number of transfers that mostly wait
+ * don't each need to hold on to buffers of their own.
+ *
+ * Returns NULL on out of memory.
+ */
+char *Curl_multi_getbuffer(struct Curl_multi *multi, size_t size)
+{
+  if(multi) {
+    struct multi_buffer **prevp = &multi->buffers;
+    struct multi_buffer *buf;
+
+    for(buf = multi->buffers; buf; buf = buf->next) {
+      if(buf->size == size) {
+        *prevp = buf->next;
+        multi->num_buffers--;
+        return (char *)buf;
+      }
+      prevp = &buf->next;
+    }
+  }
+  return malloc(size);
+}
+
+/*
+ * Curl_multi_putbuffer() gives back a buffer of 'size' bytes that was lent
+ * with Curl_multi_getbuffer(). It is kept in the pool for the next transfer
+ * to borrow, or freed if the pool is full already.
+ */
+void Curl_multi_putbuffer(struct Curl_multi *multi, char *ptr, size_t size)
+{
+  if(!ptr)
+    return;
+
+  if(multi && (multi->num_buffers < MAX_POOLED_BUFFERS) &&
+     (size >= sizeof(struct multi_buffer))) {
+    struct multi_buffer *buf = (struct multi_buffer *)(void *)ptr;
+    buf->size = size;
+    buf->next = multi->buffers;
+    multi->buffers = buf;
+    multi->num_buffers++;
+  }
+  else
+    free(ptr);
+}
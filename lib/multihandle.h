@@ -71,10 +71,20 @@ typedef enum {
 #define ENABLE_WAKEUP
 #endif
 
+#ifdef HAVE_SYS_EPOLL_H
+/* curl_multi_wait() and curl_multi_poll() use an epoll set */
+#define USE_EPOLL
+#endif
+
 
 /* value for MAXIMUM CONCURRENT STREAMS upper limit */
 #define INITIAL_MAX_CONCURRENT_STREAMS ((1U << 31) - 1)
 
+/* the largest number of unused buffers kept in the pool of a multi handle */
+#ifndef MAX_POOLED_BUFFERS
+#define MAX_POOLED_BUFFERS 4
+#endif
+
 /* This is the struct known as CURLM on the outside */
 struct Curl_multi {
   /* First a simple identifier to easier detect if a user mix up
@@ -104,12 +114,19 @@ struct Curl_multi {
 
   /* Hostname cache */
   struct curl_hash hostcache;
+  time_t hostcache_pruned; /* last time the hostname cache was pruned */
 
 #ifdef USE_LIBPSL
   /* PSL cache. */
   struct PslCache psl;
 #endif
 
+#ifdef USE_SSL
+  /* TLS backend specific data shared by the transfers of this multi handle,
+     like an already parsed CA store */
+  struct multi_ssl_backend_data *ssl_backend_data;
+#endif
+
   /* timetree points to the splay-tree of time nodes to figure out expire
      times of all currently set timers */
   struct Curl_tree *timetree;
@@ -143,11 +160,24 @@ struct Curl_multi {
                                     previous callback */
   bool in_callback;            /* true while executing a callback */
   long max_concurrent_streams; /* max concurrent streams client to support */
+  long max_http2_buffer; /* largest HTTP/2 connection buffer, 0 for default */
+  long max_cached_pushes; /* pushed responses kept per connection, 0 = none */
+
+  /* receive and upload buffers not lent to any transfer right now, see
+     Curl_multi_getbuffer() */
+  struct multi_buffer *buffers;
+  size_t num_buffers; /* number of buffers in the 'buffers' list */
 
 #ifdef ENABLE_WAKEUP
   curl_socket_t wakeup_pair[2]; /* socketpair() used for wakeup
                                    0 is used for read, 1 is used for write */
 #endif
+#ifdef USE_EPOLL
+  curl_socket_t epoll_fd; /* epoll set holding all sockets in 'sockhash',
+                             created by the first curl_multi_wait() call */
+  bool epoll_failed; /* epoll could not be used, stick to poll() */
+  bool epoll_wakeup; /* wakeup_pair[0] is in the epoll set */
+#endif
 };
 
 #endif /* HEADER_CURL_MULTIHANDLE_H */
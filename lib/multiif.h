@@ -95,4 +95,14 @@ CURLMcode Curl_multi_add_perform(struct Curl_multi *multi,
  */
 size_t Curl_multi_max_concurrent_streams(struct Curl_multi *multi);
 
+/* Return the value of the CURLMOPT_MAX_HTTP2_BUFFER option, 0 if not set */
+size_t Curl_multi_max_http2_buffer(struct Curl_multi *multi);
+
+/* Return the value of the CURLMOPT_MAX_CACHED_PUSHES option, 0 if not set */
+size_t Curl_multi_max_cached_pushes(struct Curl_multi *multi);
+
+/* Borrow a buffer from the pool of the multi handle, and give it back */
+char *Curl_multi_getbuffer(struct Curl_multi *multi, size_t size);
+void Curl_multi_putbuffer(struct Curl_multi *multi, char *buf, size_t size);
+
 #endif /* HEADER_CURL_MULTIIF_H */
@@ -47,6 +47,7 @@ int Curl_quic_ver(char *p, size_t len);
 CURLcode Curl_quic_done_sending(struct connectdata *conn);
 void Curl_quic_done(struct Curl_easy *data, bool premature);
 bool Curl_quic_data_pending(const struct Curl_easy *data);
+size_t Curl_quic_max_streams(struct connectdata *conn);
 
 #else /* ENABLE_QUIC */
 #define Curl_quic_done_sending(x)
@@ -554,8 +554,8 @@ static CURLcode pausewrite(struct Curl_easy *data,
 }
 
 
-/* chop_write() writes chunks of data not larger than CURL_MAX_WRITE_SIZE via
- * client write callback(s) and takes care of pause requests from the
+/* chop_write() writes chunks of data not larger than CURLOPT_MAX_WRITE_SIZE
+ * via client write callback(s) and takes care of pause requests from the
  * callbacks.
  */
 static CURLcode chop_write(struct connectdata *conn,
@@ -568,6 +568,7 @@ static CURLcode chop_write(struct connectdata *conn,
   curl_write_callback writebody = NULL;
   char *ptr = optr;
   size_t len = olen;
+  size_t maxchunk = data->set.max_write_size;
 
   if(!len)
     return CURLE_OK;
@@ -592,7 +593,7 @@ static CURLcode chop_write(struct connectdata *conn,
 
   /* Chop data, write chunks. */
   while(len) {
-    size_t chunklen = len <= CURL_MAX_WRITE_SIZE? len: CURL_MAX_WRITE_SIZE;
+    size_t chunklen = len <= maxchunk? len: maxchunk;
 
     if(writebody) {
       size_t wrote;
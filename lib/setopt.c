@@ -1999,8 +1999,8 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
     else if(arg < READBUFFER_MIN)
       arg = READBUFFER_MIN;
 
-    /* Resize if new size */
-    if(arg != data->set.buffer_size) {
+    /* Resize if new size, the buffer is otherwise allocated when needed */
+    if(data->state.buffer && (arg != data->set.buffer_size)) {
       char *newbuff = realloc(data->state.buffer, arg + 1);
       if(!newbuff) {
         DEBUGF(fprintf(stderr, "Error: realloc of buffer failed\n"));
@@ -2029,6 +2029,17 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
     Curl_safefree(data->state.ulbuf); /* force a realloc next opportunity */
     break;
 
+  case CURLOPT_MAX_WRITE_SIZE:
+    /*
+     * The largest amount of body data to pass to the write callback in one
+     * call. Zero means the default.
+     */
+    arg = va_arg(param, long);
+    if(arg < 0)
+      return CURLE_BAD_FUNCTION_ARGUMENT;
+    data->set.max_write_size = arg ? (size_t)arg : CURL_MAX_WRITE_SIZE;
+    break;
+
   case CURLOPT_NOSIGNAL:
     /*
      * The application asks not to set any signal() or alarm() handlers,
@@ -2048,6 +2059,7 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
 
       if(data->dns.hostcachetype == HCACHE_SHARED) {
         data->dns.hostcache = NULL;
+        data->dns.hostcache_pruned = NULL;
         data->dns.hostcachetype = HCACHE_NONE;
       }
 
@@ -2081,6 +2093,7 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
       if(data->share->specifier & (1<< CURL_LOCK_DATA_DNS)) {
         /* use shared host cache */
         data->dns.hostcache = &data->share->hostcache;
+        data->dns.hostcache_pruned = &data->share->hostcache_pruned;
         data->dns.hostcachetype = HCACHE_SHARED;
       }
 #if !defined(CURL_DISABLE_HTTP) && !defined(CURL_DISABLE_COOKIES)
@@ -2141,6 +2154,8 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
       (bool)((arg&CURLSSLOPT_ALLOW_BEAST) ? TRUE : FALSE);
     data->set.ssl.no_revoke = !!(arg & CURLSSLOPT_NO_REVOKE);
     data->set.ssl.no_partialchain = !!(arg & CURLSSLOPT_NO_PARTIALCHAIN);
+    data->set.ssl.earlydata = !!(arg & CURLSSLOPT_EARLYDATA);
+    data->set.ssl.ktls = !!(arg & CURLSSLOPT_KTLS);
     break;
 
 #ifndef CURL_DISABLE_PROXY
@@ -2255,6 +2270,16 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
     data->set.proxy_ssl.primary.sessionid = data->set.ssl.primary.sessionid;
     break;
 
+  case CURLOPT_SSL_SESSION_FILE:
+    /*
+     * File to load TLS sessions from before the first transfer and to save
+     * them to when the handle is closed.
+     */
+    result = Curl_setstropt(&data->set.str[STRING_SSL_SESSION_FILE],
+                            va_arg(param, char *));
+    data->state.sessionfile_loaded = FALSE;
+    break;
+
 #ifdef USE_SSH
     /* we only include SSH options if explicitly built to support SSH */
   case CURLOPT_SSH_AUTH_TYPES:
@@ -2721,6 +2746,12 @@ CURLcode Curl_vsetopt(struct Curl_easy *data, CURLoption option, va_list param)
     data->set.trailer_data = va_arg(param, void *);
 #endif
     break;
+  case CURLOPT_RECV_BUFFER_FUNCTION:
+    data->set.recv_buffer_func = va_arg(param, curl_recv_buffer_callback);
+    break;
+  case CURLOPT_RECV_BUFFER_DATA:
+    data->set.recv_buffer_data = va_arg(param, void *);
+    break;
 #ifdef USE_ALTSVC
   case CURLOPT_ALTSVC:
     if(!data->asi) {
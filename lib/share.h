@@ -47,6 +47,7 @@ struct Curl_share {
   void *clientdata;
   struct conncache conn_cache;
   struct curl_hash hostcache;
+  time_t hostcache_pruned; /* last time the hostname cache was pruned */
 #if !defined(CURL_DISABLE_HTTP) && !defined(CURL_DISABLE_COOKIES)
   struct CookieInfo *cookies;
 #endif
@@ -57,6 +58,7 @@ struct Curl_share {
   struct curl_ssl_session *sslsession;
   size_t max_ssl_sessions;
   long sessionage;
+  long sessionchanges;
 };
 
 CURLSHcode Curl_share_lock(struct Curl_easy *, curl_lock_data,
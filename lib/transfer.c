@@ -110,13 +110,38 @@ char *Curl_checkheaders(const struct connectdata *conn,
 CURLcode Curl_get_upload_buffer(struct Curl_easy *data)
 {
   if(!data->state.ulbuf) {
-    data->state.ulbuf = malloc(data->set.upload_buffer_size);
+    data->state.ulbuf = Curl_multi_getbuffer(data->multi,
+                                             data->set.upload_buffer_size);
     if(!data->state.ulbuf)
       return CURLE_OUT_OF_MEMORY;
   }
   return CURLE_OK;
 }
 
+/* give the upload buffer back to the pool of the multi handle */
+void Curl_release_upload_buffer(struct Curl_easy *data)
+{
+  Curl_multi_putbuffer(data->multi, data->state.ulbuf,
+                       data->set.upload_buffer_size);
+  data->state.ulbuf = NULL;
+}
+
+/*
+ * The receive buffer is only allocated for transfers that keep data in it
+ * between calls, like the protocols with a control connection and HTTP/3
+ * streams. HTTP over TCP borrows a buffer from the multi handle for each read
+ * instead, and an HTTP/2 stream for as long as received data waits for it.
+ */
+CURLcode Curl_get_download_buffer(struct Curl_easy *data)
+{
+  if(!data->state.buffer) {
+    data->state.buffer = malloc(data->set.buffer_size + 1);
+    if(!data->state.buffer)
+      return CURLE_OUT_OF_MEMORY;
+  }
+  return CURLE_OK;
+}
+
 #ifndef CURL_DISABLE_HTTP
 /*
  * This function will be called to loop through the trailers buffer
@@ -539,6 +564,47 @@ bool Curl_meets_timecondition(struct Curl_easy *data, time_t timeofdoc)
   return TRUE;
 }
 
+/*
+ * recv_buffer() asks the application for memory to receive the next chunk of
+ * body data straight into, so that the write callback is then called with a
+ * pointer into that same memory. Only plain body data that is passed on
+ * unmodified can be received like this, everything else uses the internal
+ * buffer. Returns NULL when the internal buffer should be used.
+ */
+static char *recv_buffer(struct Curl_easy *data,
+                         struct connectdata *conn,
+                         struct SingleRequest *k,
+                         size_t *bytestoread)
+{
+  char *mem;
+  size_t size = *bytestoread;
+
+  if(!data->set.recv_buffer_func || k->header || k->chunk ||
+     k->ignorebody || k->badheader || !k->bodywrites ||
+     conn->handler->readwrite ||
+     (k->writer_stack && !data->set.http_ce_skip) ||
+     (conn->transport == TRNSPRT_QUIC) ||
+     /* a HTTP/2 stream may keep on storing data in the buffer between the
+        reads, which it can't do in memory owned by the application */
+     ((conn->handler->protocol & PROTO_FAMILY_HTTP) &&
+      (conn->httpversion == 20)) ||
+     /* FTP ASCII transfers are converted in place */
+     ((conn->handler->protocol & PROTO_FAMILY_FTP) &&
+      (conn->proto.ftpc.transfertype == 'A')))
+    return NULL;
+
+  Curl_set_in_callback(data, true);
+  mem = data->set.recv_buffer_func(&size, data->set.recv_buffer_data);
+  Curl_set_in_callback(data, false);
+
+  if(!mem || !size)
+    return NULL;
+
+  if(size < *bytestoread)
+    *bytestoread = size;
+  return mem;
+}
+
 /*
  * Go ahead and do a read if we have a readable socket or if
  * the stream was rewound (in which case we have data in a
@@ -557,6 +623,7 @@ static CURLcode readwrite_data(struct Curl_easy *data,
   ssize_t nread; /* number of bytes read */
   size_t excess = 0; /* excess bytes read */
   bool readmore = FALSE; /* used by RTP to signal for more data */
+  bool fullread = FALSE; /* the last read filled the entire buffer */
   int maxloops = 100;
 
   *done = FALSE;
@@ -588,8 +655,14 @@ static CURLcode readwrite_data(struct Curl_easy *data,
     }
 
     if(bytestoread) {
+      char *appbuf = recv_buffer(data, conn, k, &bytestoread);
+
       /* receive data from the network! */
-      result = Curl_read(conn, conn->sockfd, k->buf, bytestoread, &nread);
+      k->recvbuf = NULL;
+      result = Curl_read(conn, conn->sockfd, appbuf ? appbuf : k->buf,
+                         bytestoread, &nread);
+      if(appbuf && !k->recvbuf)
+        k->recvbuf = appbuf;
 
       /* read would've blocked */
       if(CURLE_AGAIN == result)
@@ -597,12 +670,20 @@ static CURLcode readwrite_data(struct Curl_easy *data,
 
       if(result>0)
         return result;
+
+      /* a read that filled the whole buffer most likely left more data in
+         the socket, so read again right away instead of first waiting for
+         the socket to get reported readable again. Not when the speed is
+         limited, as that is checked between reads. */
+      fullread = (nread > 0) && ((size_t)nread == bytestoread) &&
+        !data->set.max_recv_speed;
     }
     else {
       /* read nothing but since we wanted nothing we consider this an OK
          situation to proceed from */
       DEBUGF(infof(data, "readwrite_data: we're done!\n"));
       nread = 0;
+      fullread = FALSE;
     }
 
     if(!k->bytecount) {
@@ -618,7 +699,8 @@ static CURLcode readwrite_data(struct Curl_easy *data,
 
     /* NUL terminate, allowing string ops to be used */
     if(0 < nread || is_empty_data) {
-      k->buf[nread] = 0;
+      if(!k->recvbuf)
+        k->buf[nread] = 0;
     }
     else {
       /* if we receive 0 or less here, the server closed the connection
@@ -630,7 +712,7 @@ static CURLcode readwrite_data(struct Curl_easy *data,
 
     /* Default buffer to use when we write the buffer, it may be changed
        in the flow below before the actual storing is done. */
-    k->str = k->buf;
+    k->str = k->recvbuf ? k->recvbuf : k->buf;
 
     if(conn->handler->readwrite) {
       result = conn->handler->readwrite(data, conn, &nread, &readmore);
@@ -918,14 +1000,21 @@ static CURLcode readwrite_data(struct Curl_easy *data,
 
     if(k->keepon & KEEP_RECV_PAUSE) {
       /* this is a paused transfer */
+      if(k->recvbuf) {
+        /* the HTTP/2 data it was handed in place has been kept aside */
+        result = Curl_http2_recv_paused(conn);
+        if(result)
+          return result;
+      }
       break;
     }
 
-  } while(data_pending(data) && maxloops--);
+  } while(((fullread && (k->keepon & KEEP_RECV)) || data_pending(data)) &&
+          maxloops--);
 
   if(maxloops <= 0) {
     /* we mark it as read-again-please */
-    conn->cselect_bits = CURL_CSELECT_IN;
+    data->state.select_bits = CURL_CSELECT_IN;
     *comeback = TRUE;
   }
 
@@ -992,6 +1081,8 @@ static CURLcode readwrite_upload(struct Curl_easy *data,
   ssize_t nread; /* number of bytes read */
   bool sending_http_headers = FALSE;
   struct SingleRequest *k = &data->req;
+  bool again;
+  int maxloops = 100;
 
   if((k->bytecount == 0) && (k->writebytecount == 0))
     Curl_pgrsTime(data, TIMER_STARTTRANSFER);
@@ -999,6 +1090,7 @@ static CURLcode readwrite_upload(struct Curl_easy *data,
   *didwhat |= KEEP_SEND;
 
   do {
+    again = FALSE;
     /* only read more data if there's no upload data already
        present in the upload buffer */
     if(0 == k->upload_present) {
@@ -1173,11 +1265,21 @@ static CURLcode readwrite_upload(struct Curl_easy *data,
         result = Curl_done_sending(conn, k);
         if(result)
           return result;
+        /* all sent, the buffer isn't needed while waiting for the response */
+        Curl_release_upload_buffer(data);
       }
+#if defined(USE_NGHTTP2)
+      else if((conn->handler->protocol & PROTO_FAMILY_HTTP) &&
+              (conn->httpversion == 20) && !data->set.max_send_speed)
+        /* HTTP/2 framed all of it and neither the socket nor the flow
+           control windows said stop, so more can go right away instead of
+           waiting for another round. Not when the speed is limited, as
+           that is checked between rounds. */
+        again = TRUE;
+#endif
     }
 
-
-  } while(0); /* just to break out from! */
+  } while(again && --maxloops);
 
   return CURLE_OK;
 }
@@ -1200,9 +1302,11 @@ CURLcode Curl_readwrite(struct connectdata *conn,
 
   curl_socket_t fd_read;
   curl_socket_t fd_write;
-  int select_res = conn->cselect_bits;
+  int select_res = data->state.select_bits;
+  bool select_known = data->state.select_known;
 
-  conn->cselect_bits = 0;
+  data->state.select_bits = 0;
+  data->state.select_known = FALSE;
 
   /* only use the proper socket if the *_HOLD bit is not set simultaneously as
      then we are in rate limiting state in that transfer direction */
@@ -1222,8 +1326,8 @@ CURLcode Curl_readwrite(struct connectdata *conn,
     DEBUGF(infof(data, "Curl_readwrite: forcibly told to drain data\n"));
   }
 
-  if(!select_res) /* Call for select()/poll() only, if read/write/error
-                     status is not known. */
+  if(!select_res && !select_known) /* Call for select()/poll() only, if
+                                      read/write/error status is not known. */
     select_res = Curl_socket_check(fd_read, CURL_SOCKET_BAD, fd_write, 0);
 
   if(select_res == CURL_CSELECT_ERR) {
@@ -1236,8 +1340,25 @@ CURLcode Curl_readwrite(struct connectdata *conn,
      buffer) */
   if((k->keepon & KEEP_RECV) &&
      ((select_res & CURL_CSELECT_IN) || conn->bits.stream_was_rewound)) {
+    char *lent = NULL;
+    size_t lentsize = data->set.buffer_size + 1;
+
+    if(data->state.buffer)
+      k->buf = data->state.buffer;
+    else {
+      /* no receive buffer of its own, borrow one for this read only */
+      lent = Curl_multi_getbuffer(data->multi, lentsize);
+      if(!lent)
+        return CURLE_OUT_OF_MEMORY;
+      k->buf = lent;
+    }
 
     result = readwrite_data(data, conn, k, &didwhat, done, comeback);
+
+    if(lent) {
+      Curl_multi_putbuffer(data->multi, lent, lentsize);
+      k->buf = data->state.buffer;
+    }
     if(result || *done)
       return result;
   }
@@ -1445,6 +1566,8 @@ CURLcode Curl_pretransfer(struct Curl_easy *data)
      after the *_setopt() calls (that could specify the size of the cache) but
      before any transfer takes place. */
   result = Curl_ssl_initsessions(data, data->set.general_ssl.max_ssl_sessions);
+  if(!result)
+    result = Curl_ssl_load_sessions(data);
   if(result)
     return result;
 
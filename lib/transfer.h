@@ -54,6 +54,8 @@ CURLcode Curl_fillreadbuffer(struct connectdata *conn, size_t bytes,
 CURLcode Curl_retry_request(struct connectdata *conn, char **url);
 bool Curl_meets_timecondition(struct Curl_easy *data, time_t timeofdoc);
 CURLcode Curl_get_upload_buffer(struct Curl_easy *data);
+void Curl_release_upload_buffer(struct Curl_easy *data);
+CURLcode Curl_get_download_buffer(struct Curl_easy *data);
 
 CURLcode Curl_done_sending(struct connectdata *conn,
                            struct SingleRequest *k);
@@ -104,6 +104,7 @@ bool curl_win32_idn_to_ascii(const char *in, char **out);
 #include "tftp.h"
 #include "http.h"
 #include "http2.h"
+#include "quic.h"
 #include "file.h"
 #include "curl_ldap.h"
 #include "vssh/ssh.h"
@@ -359,8 +360,10 @@ CURLcode Curl_close(struct Curl_easy **datap)
   Curl_free_request_state(data);
 
   /* Close down all open SSL info and sessions */
+  Curl_ssl_save_sessions(data);
   Curl_ssl_close_all(data);
   Curl_safefree(data->state.first_host);
+  Curl_safefree(data->state.req_host);
   Curl_safefree(data->state.scratch);
   Curl_ssl_free_certinfo(data);
 
@@ -460,7 +463,7 @@ CURLcode Curl_init_userdefined(struct Curl_easy *data)
   set->dns_cache_timeout = 60; /* Timeout every 60 seconds by default */
 
   /* Set the default size of the SSL session ID cache */
-  set->general_ssl.max_ssl_sessions = 5;
+  set->general_ssl.max_ssl_sessions = 25;
 
   set->proxyport = 0;
   set->proxytype = CURLPROXY_HTTP; /* defaults to HTTP proxy */
@@ -550,6 +553,7 @@ CURLcode Curl_init_userdefined(struct Curl_easy *data)
   set->sep_headers = TRUE; /* separated header lists by default */
   set->buffer_size = READBUFFER_SIZE;
   set->upload_buffer_size = UPLOADBUFFER_DEFAULT;
+  set->max_write_size = CURL_MAX_WRITE_SIZE;
   set->happy_eyeballs_timeout = CURL_HET_DEFAULT;
   set->fnmatch = ZERO_NULL;
   set->upkeep_interval_ms = CURL_UPKEEP_INTERVAL_DEFAULT;
@@ -597,37 +601,31 @@ CURLcode Curl_open(struct Curl_easy **curl)
     return result;
   }
 
-  /* We do some initial setup here, all those fields that can't be just 0 */
+  /* We do some initial setup here, all those fields that can't be just 0.
+     The receive buffer is allocated on demand, see
+     Curl_get_download_buffer() */
 
-  data->state.buffer = malloc(READBUFFER_SIZE + 1);
-  if(!data->state.buffer) {
-    DEBUGF(fprintf(stderr, "Error: malloc of buffer failed\n"));
+  data->state.headerbuff = malloc(HEADERSIZE);
+  if(!data->state.headerbuff) {
+    DEBUGF(fprintf(stderr, "Error: malloc of headerbuff failed\n"));
     result = CURLE_OUT_OF_MEMORY;
   }
   else {
-    data->state.headerbuff = malloc(HEADERSIZE);
-    if(!data->state.headerbuff) {
-      DEBUGF(fprintf(stderr, "Error: malloc of headerbuff failed\n"));
-      result = CURLE_OUT_OF_MEMORY;
-    }
-    else {
-      result = Curl_init_userdefined(data);
+    result = Curl_init_userdefined(data);
 
-      data->state.headersize = HEADERSIZE;
-      Curl_convert_init(data);
-      Curl_initinfo(data);
+    data->state.headersize = HEADERSIZE;
+    Curl_convert_init(data);
+    Curl_initinfo(data);
 
-      /* most recent connection is not yet defined */
-      data->state.lastconnect = NULL;
+    /* most recent connection is not yet defined */
+    data->state.lastconnect = NULL;
 
-      data->progress.flags |= PGRS_HIDE;
-      data->state.current_speed = -1; /* init to negative == impossible */
-    }
+    data->progress.flags |= PGRS_HIDE;
+    data->state.current_speed = -1; /* init to negative == impossible */
   }
 
   if(result) {
     Curl_resolver_cleanup(data->state.resolver);
-    free(data->state.buffer);
     free(data->state.headerbuff);
     Curl_freeset(data);
     free(data);
@@ -780,6 +778,8 @@ static void conn_free(struct connectdata *conn)
 CURLcode Curl_disconnect(struct Curl_easy *data,
                          struct connectdata *conn, bool dead_connection)
 {
+  char *lentbuf = NULL;
+
   if(!conn)
     return CURLE_OK; /* this is closed and fine already */
 
@@ -821,10 +821,26 @@ CURLcode Curl_disconnect(struct Curl_easy *data,
     /* treat the connection as dead in CONNECT_ONLY situations */
     dead_connection = TRUE;
 
+  if(conn->handler->disconnect && !dead_connection && !data->state.buffer) {
+    /* the transfer closing the connection, like the one of the connection
+       cache, may not have a receive buffer of its own. Saying goodbye to
+       the server needs one, borrow it for that. */
+    lentbuf = Curl_multi_getbuffer(data->multi, data->set.buffer_size + 1);
+    if(lentbuf)
+      data->state.buffer = lentbuf;
+    else
+      dead_connection = TRUE;
+  }
+
   if(conn->handler->disconnect)
     /* This is set if protocol-specific cleanups should be made */
     conn->handler->disconnect(conn, dead_connection);
 
+  if(lentbuf) {
+    Curl_multi_putbuffer(data->multi, lentbuf, data->set.buffer_size + 1);
+    data->state.buffer = NULL;
+  }
+
   conn_shutdown(conn);
   conn_free(conn);
   return CURLE_OK;
@@ -996,6 +1012,156 @@ static void prune_dead_connections(struct Curl_easy *data)
   }
 }
 
+#ifdef USE_NGHTTP2
+struct coalesce_find {
+  struct Curl_easy *data;
+  struct connectdata *needle;
+  const Curl_addrinfo *addr;    /* the addresses the needle's host has */
+  struct connectdata *found;
+};
+
+UNITTEST bool coalesce_match(struct connectdata *check,
+                             struct connectdata *needle,
+                             struct Curl_multi *multi,
+                             const Curl_addrinfo *addr);
+/*
+ * coalesce_match() returns TRUE if the needle's request can use the
+ * connection 'check', as far as this can be told without looking at the
+ * server certificate. 'addr' is the list of addresses the needle's host
+ * name resolves to.
+ *
+ * Only connections that other transfers use are taken. An idle one may have
+ * been closed by the server or be too old to reuse, and those checks are
+ * only done for connections to the same host in ConnectionExists().
+ *
+ * Not declared static only to make it easy to use in a unit test!
+ *
+ * @unittest: 1656
+ */
+UNITTEST bool coalesce_match(struct connectdata *check,
+                             struct connectdata *needle,
+                             struct Curl_multi *multi,
+                             const Curl_addrinfo *addr)
+{
+  const Curl_addrinfo *ai;
+  char ipaddr[MAX_IPADR_LEN];
+
+  if(!CONN_INUSE(check) ||
+     !check->bits.multiplex || check->bits.close || check->bits.connect_only ||
+     !check->bundle || (check->bundle->multiuse != BUNDLE_MULTIPLEX) ||
+     (check->handler->protocol != needle->handler->protocol) ||
+     (check->transport != needle->transport) ||
+     (check->remote_port != needle->remote_port) ||
+     check->bits.httpproxy || check->bits.socksproxy ||
+     check->bits.conn_to_host || check->bits.conn_to_port)
+    return FALSE;
+
+#ifdef USE_UNIX_SOCKETS
+  if(check->unix_domain_socket)
+    return FALSE;
+#endif
+#ifdef USE_NTLM
+  if(check->http_ntlm_state != NTLMSTATE_NONE)
+    return FALSE;
+#endif
+#ifdef USE_SPNEGO
+  if(check->http_negotiate_state != GSS_AUTHNONE)
+    return FALSE;
+#endif
+
+  if(check->data && (check->data->multi != multi))
+    return FALSE;
+
+  if(CONN_INUSE(check) >= check->proto.httpc.settings.max_concurrent_streams)
+    return FALSE;
+
+  if(!Curl_ssl_config_matches(&needle->ssl_config, &check->ssl_config))
+    return FALSE;
+
+  /* the needle's host must resolve to the address this connection uses */
+  for(ai = addr; ai; ai = ai->ai_next) {
+    if(Curl_printable_address(ai, ipaddr, sizeof(ipaddr)) &&
+       !strcmp(ipaddr, check->primary_ip))
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/*
+ * Curl_conncache_foreach() callback for coalesce_connection(). Returns 1 and
+ * takes the connection if the needle's request can use it.
+ */
+static int coalesce_check(struct connectdata *check, void *param)
+{
+  struct coalesce_find *f = (struct coalesce_find *)param;
+
+  if(!coalesce_match(check, f->needle, f->data->multi, f->addr))
+    return 0;
+
+  /* the server certificate must be valid for the needle's host as well */
+  if(!Curl_ssl_peer_cert_matches(check, FIRSTSOCKET, f->needle->host.name))
+    return 0;
+
+  check->data = f->data; /* own it! */
+  f->found = check;
+  return 1;
+}
+
+/*
+ * An HTTP/2 connection can be used for requests to other hosts than the one
+ * it was made for, as long as these resolve to the same address and the
+ * server certificate is valid for them as well (RFC 7540 section 9.1.1).
+ *
+ * Find such a connection for the needle. This is only done if the needle's
+ * host name is already in the DNS cache, as there is no waiting for a name
+ * resolve here.
+ */
+static struct connectdata *coalesce_connection(struct Curl_easy *data,
+                                               struct connectdata *needle)
+{
+  struct coalesce_find f;
+  struct Curl_dns_entry *dns;
+
+  if(!(needle->handler->protocol & CURLPROTO_HTTPS) ||
+     !(IsMultiplexingPossible(data, needle) & CURLPIPE_MULTIPLEX) ||
+     needle->bits.httpproxy || needle->bits.socksproxy ||
+     needle->bits.conn_to_host || needle->bits.conn_to_port ||
+     needle->bits.ipv6_ip || needle->localdev || needle->localport ||
+     !needle->ssl_config.verifypeer || !needle->ssl_config.verifyhost)
+    return NULL;
+
+#ifdef USE_UNIX_SOCKETS
+  if(needle->unix_domain_socket)
+    return NULL;
+#endif
+#ifdef USE_NTLM
+  if(data->state.authhost.want & (CURLAUTH_NTLM | CURLAUTH_NTLM_WB))
+    return NULL;
+#endif
+#ifdef USE_SPNEGO
+  /* the Negotiate state is kept in the connection, for its host name */
+  if(data->state.authhost.want & CURLAUTH_NEGOTIATE)
+    return NULL;
+#endif
+
+  dns = Curl_fetch_addr(needle, needle->host.name, (int)needle->port);
+  if(!dns)
+    return NULL;
+
+  f.data = data;
+  f.needle = needle;
+  f.addr = dns->addr;
+  f.found = NULL;
+  Curl_conncache_foreach(data, data->state.conn_cache, &f, coalesce_check);
+  Curl_resolv_unlock(data, dns);
+
+  if(f.found)
+    infof(data, "Coalescing with connection #%ld to %s\n",
+          f.found->connection_id, f.found->primary_ip);
+  return f.found;
+}
+#endif
+
 /*
  * Given one filled in connection struct (named needle), this function should
  * detect if there already is one that has all the significant details
@@ -1073,7 +1239,7 @@ ConnectionExists(struct Curl_easy *data,
     curr = bundle->conn_list.head;
     while(curr) {
       bool match = FALSE;
-      size_t multiplexed;
+      size_t multiplexed = 0;
 
       /*
        * Note that if we use a HTTP proxy in normal mode (no tunneling), we
@@ -1086,8 +1252,8 @@ ConnectionExists(struct Curl_easy *data,
         /* connect-only or to-be-closed connections will not be reused */
         continue;
 
-      multiplexed = CONN_INUSE(check) &&
-        (bundle->multiuse == BUNDLE_MULTIPLEX);
+      if(bundle->multiuse == BUNDLE_MULTIPLEX)
+        multiplexed = CONN_INUSE(check);
 
       if(canmultiplex) {
         ;
@@ -1144,6 +1310,11 @@ ConnectionExists(struct Curl_easy *data,
          needle->bits.socksproxy != check->bits.socksproxy)
         continue;
 
+      if(needle->transport != check->transport)
+        /* an HTTP/3 request needs a QUIC connection and the other way
+           around */
+        continue;
+
       if(needle->bits.socksproxy && !proxy_info_matches(&needle->socks_proxy,
                                                         &check->socks_proxy))
         continue;
@@ -1337,16 +1508,39 @@ ConnectionExists(struct Curl_easy *data,
             break;
           }
 
-#ifdef USE_NGHTTP2
+#if defined(USE_NGHTTP2) || defined(ENABLE_QUIC)
           /* If multiplexed, make sure we don't go over concurrency limit */
           if(check->bits.multiplex) {
-            /* Multiplexed connections can only be HTTP/2 for now */
-            struct http_conn *httpc = &check->proto.httpc;
-            if(multiplexed >= httpc->settings.max_concurrent_streams) {
+            size_t maxstreams = 0;
+            bool lessbusy;
+#ifdef ENABLE_QUIC
+            if(check->transport == TRNSPRT_QUIC) {
+              /* HTTP/3, each transfer opens a new QUIC stream */
+              maxstreams = Curl_quic_max_streams(check);
+              lessbusy = !chosen || (multiplexed < CONN_INUSE(chosen));
+            }
+            else
+#endif
+            {
+#ifdef USE_NGHTTP2
+              struct http_conn *httpc = &check->proto.httpc;
+              maxstreams = httpc->settings.max_concurrent_streams;
+#endif
+              lessbusy = !chosen || Curl_http2_less_busy(check, chosen);
+            }
+            if(multiplexed >= maxstreams) {
               infof(data, "MAX_CONCURRENT_STREAMS reached, skip (%zu)\n",
                     multiplexed);
               continue;
             }
+
+            /* Spread the streams over all connections to this host. Keep
+               looking for the one with the least streams in use. When all
+               of them are full, a new connection gets made, up to
+               CURLMOPT_MAX_HOST_CONNECTIONS. */
+            if(lessbusy)
+              chosen = check;
+            continue;
           }
 #endif
           /* When not multiplexed, we have a match here! */
@@ -1364,6 +1558,9 @@ ConnectionExists(struct Curl_easy *data,
   }
 
   if(chosen) {
+    if(chosen->bits.multiplex)
+      infof(data, "Multiplexed connection found! (#%ld, %zu streams)\n",
+            chosen->connection_id, CONN_INUSE(chosen));
     /* mark it as used before releasing the lock */
     chosen->data = data; /* own it! */
     Curl_conncache_unlock(data);
@@ -1372,6 +1569,14 @@ ConnectionExists(struct Curl_easy *data,
   }
   Curl_conncache_unlock(data);
 
+#ifdef USE_NGHTTP2
+  chosen = coalesce_connection(data, needle);
+  if(chosen) {
+    *usethis = chosen;
+    return TRUE;
+  }
+#endif
+
   if(foundPendingCandidate && data->set.pipewait) {
     infof(data,
           "Found pending candidate for reuse and CURLOPT_PIPEWAIT is set\n");
@@ -3845,6 +4050,20 @@ CURLcode Curl_connect(struct Curl_easy *data,
   /* call the stuff that needs to be called */
   result = create_conn(data, &conn, asyncp);
 
+  if(!result) {
+    free(data->state.req_host);
+    data->state.req_host = strdup(conn->host.name);
+    if(!data->state.req_host)
+      result = CURLE_OUT_OF_MEMORY;
+  }
+
+  if(!result &&
+     (!(conn->handler->protocol & PROTO_FAMILY_HTTP) ||
+      (conn->transport == TRNSPRT_QUIC)))
+    /* these keep data in the receive buffer between calls so they need one
+       of their own, HTTP over TCP borrows one when it needs it */
+    result = Curl_get_download_buffer(data);
+
   if(!result) {
     if(CONN_INUSE(conn))
       /* multiplexed */
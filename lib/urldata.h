@@ -258,12 +258,20 @@ struct ssl_config_data {
   BIT(enable_beast); /* allow this flaw for interoperability's sake*/
   BIT(no_revoke);    /* disable SSL certificate revocation checks */
   BIT(no_partialchain); /* don't accept partial certificate chains */
+  BIT(earlydata);    /* send safe requests as TLS 1.3 early data */
+  BIT(ktls);         /* let the kernel do the record encryption */
 };
 
 struct ssl_general_config {
   size_t max_ssl_sessions; /* SSL session id cache size */
 };
 
+/* a peer certificate kept to extract the CURLINFO_CERTINFO fields from */
+struct certder {
+  char *der;    /* the DER encoded certificate, or NULL */
+  size_t len;
+};
+
 /* information stored about one single SSL session */
 struct curl_ssl_session {
   char *name;       /* host name for which this ID was used */
@@ -274,6 +282,7 @@ struct curl_ssl_session {
   long age;         /* just a number, the higher the more recent */
   int remote_port;  /* remote port */
   int conn_to_port; /* remote port for the connection (may be -1) */
+  unsigned int hash; /* of name and remote_port, for quicker lookups */
   struct ssl_primary_config ssl_config; /* setup for this session */
 };
 
@@ -621,6 +630,9 @@ struct SingleRequest {
   time_t timeofdoc;
   long bodywrites;
   char *buf;
+  char *recvbuf;    /* when set, the last Curl_read() left the data here
+                       instead of in 'buf'. It is only valid until the next
+                       read. */
   int keepon;
   char *location;   /* This points to an allocated version of the Location:
                        header data */
@@ -1051,7 +1063,6 @@ struct connectdata {
     struct ldapconninfo *ldapc;
   } proto;
 
-  int cselect_bits; /* bitmask of socket events */
   int waitfor;      /* current READ/WRITE bits to wait for */
 
 #if defined(HAVE_GSSAPI) || defined(USE_WINDOWS_SSPI)
@@ -1123,6 +1134,8 @@ struct PureInfo {
                                  OpenSSL, GnuTLS, Schannel, NSS and GSKit
                                  builds. Asked for with CURLOPT_CERTINFO
                                  / CURLINFO_CERTINFO */
+  struct certder *certder;    /* certificates not yet formatted into certs,
+                                 one per cert, see Curl_complete_certinfo() */
   BIT(timecond);  /* set to TRUE if the time condition didn't match, which
                      thus made the document NOT get fetched */
 };
@@ -1317,8 +1330,15 @@ struct UrlState {
                        strdup() data.
                     */
   int first_remote_port; /* remote port of the first (not followed) request */
+  char *req_host; /* host name of the current request. The host name of the
+                     connection changes when it gets used for requests to
+                     other hosts as well (HTTP/2 coalescing), while this
+                     request may not be done yet. This is strdup() data. */
   struct curl_ssl_session *session; /* array of 'max_ssl_sessions' size */
   long sessionage;                  /* number of the most recent session */
+  long sessionchanges;   /* number of changes made to the session cache */
+  long sessionfile_changes; /* 'sessionchanges' when CURLOPT_SSL_SESSION_FILE
+                               was last read or written */
   unsigned int tempcount; /* number of entries in use in tempwrite, 0 - 3 */
   struct tempbuf tempwrite[3]; /* BOTH, HEADER, BODY */
   char *scratch; /* huge buffer[set.buffer_size*2] for upload CRLF replacing */
@@ -1374,6 +1394,8 @@ struct UrlState {
   size_t drain; /* Increased when this stream has data to read, even if its
                    socket is not necessarily is readable. Decreased when
                    checked. */
+  int select_bits; /* != 0 -> bitmask of socket events for this transfer
+                      overriding anything the socket may report */
 
   curl_read_callback fread_func; /* read callback/function */
   void *in;                      /* CURLOPT_READDATA */
@@ -1396,6 +1418,9 @@ struct UrlState {
      the easy handle so curl_easy_cleanup() on such an easy handle will
      also close the multi handle! */
   BIT(multi_owned_by_easy);
+  BIT(select_known); /* select_bits holds the outcome of a socket check done
+                        by the multi, even when it is zero */
+  BIT(sessionfile_loaded); /* CURLOPT_SSL_SESSION_FILE has been read */
 
   BIT(this_is_a_follow); /* this is a followed Location: request */
   BIT(refused_stream); /* this was refused, try again */
@@ -1534,6 +1559,7 @@ enum dupstring {
   STRING_ALTSVC,                /* CURLOPT_ALTSVC */
 #endif
   STRING_SASL_AUTHZID,          /* CURLOPT_SASL_AUTHZID */
+  STRING_SSL_SESSION_FILE,      /* CURLOPT_SSL_SESSION_FILE */
 #ifndef CURL_DISABLE_PROXY
   STRING_TEMP_URL,              /* temp URL storage for proxy use */
 #endif
@@ -1657,6 +1683,7 @@ struct UserDefined {
   long buffer_size;      /* size of receive buffer to use */
   size_t upload_buffer_size; /* size of upload buffer to use,
                                 keep it >= CURL_MAX_WRITE_SIZE */
+  size_t max_write_size; /* largest body chunk for the write callback */
   void *private_data; /* application-private data */
   struct curl_slist *http200aliases; /* linked list of aliases for http200 */
   long ipver; /* the CURL_IPRESOLVE_* defines in the public header file
@@ -1717,6 +1744,8 @@ struct UserDefined {
   CURLU *uh; /* URL handle for the current parsed URL */
   void *trailer_data; /* pointer to pass to trailer data callback */
   curl_trailer_callback trailer_callback; /* trailing data callback */
+  curl_recv_buffer_callback recv_buffer_func; /* receive memory callback */
+  void *recv_buffer_data; /* pointer to pass to the receive memory callback */
   BIT(is_fread_set); /* has read callback been set to non-NULL? */
   BIT(is_fwrite_set); /* has write callback been set to non-NULL? */
   BIT(free_referer); /* set TRUE if 'referer' points to a string we
@@ -1797,6 +1826,8 @@ struct UserDefined {
 
 struct Names {
   struct curl_hash *hostcache;
+  time_t *hostcache_pruned; /* when 'hostcache' was last pruned, this is
+                               stored by the owner of the cache */
   enum {
     HCACHE_NONE,    /* not pointing to anything */
     HCACHE_MULTI,   /* points to a shared one in the multi handle */
@@ -27,6 +27,9 @@
 #include <ngtcp2/ngtcp2_crypto.h>
 #include <nghttp3/nghttp3.h>
 #include <openssl/err.h>
+#ifdef HAVE_NETINET_UDP_H
+#include <netinet/udp.h>
+#endif
 #include "urldata.h"
 #include "sendf.h"
 #include "strdup.h"
@@ -66,6 +69,9 @@ struct h3out {
                     data block */
 };
 
+/* HTTP/3 error code for a request the client no longer wants */
+#define H3_REQUEST_CANCELLED 0x10c
+
 #define QUIC_MAX_STREAMS (256*1024)
 #define QUIC_MAX_DATA (1*1024*1024)
 #define QUIC_IDLE_TIMEOUT 60000 /* milliseconds */
@@ -74,6 +80,15 @@ struct h3out {
   "POLY1305_SHA256:TLS_AES_128_CCM_SHA256"
 #define QUIC_GROUPS "P-256:X25519:P-384:P-521"
 
+/* Linux can send a train of equally sized packets with one system call and
+   hand back several received ones at once (UDP GSO and GRO) */
+#if defined(__linux__) && defined(UDP_SEGMENT) && defined(UDP_GRO)
+#define QUIC_UDP_OFFLOAD
+#endif
+
+/* the largest number of packets sent with one call */
+#define QUIC_SEND_BATCH 16
+
 static CURLcode ng_process_ingress(struct connectdata *conn,
                                    curl_socket_t sockfd,
                                    struct quicsocket *qs);
@@ -410,6 +425,10 @@ static int cb_stream_close(ngtcp2_conn *tconn, int64_t stream_id,
   (void)stream_user_data;
   /* stream is closed... */
 
+  if(!(stream_id & 3) && qs->active_bidi)
+    /* a client-initiated bidirectional stream, one of our requests */
+    qs->active_bidi--;
+
   rv = nghttp3_conn_close_stream(qs->h3conn, stream_id,
                                  app_error_code);
   if(rv != 0) {
@@ -460,10 +479,12 @@ static int cb_extend_max_local_streams_bidi(ngtcp2_conn *tconn,
                                             uint64_t max_streams,
                                             void *user_data)
 {
+  struct quicsocket *qs = (struct quicsocket *)user_data;
   (void)tconn;
-  (void)max_streams;
-  (void)user_data;
 
+  /* the server allows this many request streams in total, see
+     Curl_quic_max_streams() */
+  qs->max_bidi_streams = max_streams;
   return 0;
 }
 
@@ -597,6 +618,14 @@ CURLcode Curl_quic_connect(struct connectdata *conn,
   if(rv == -1)
     return CURLE_FAILED_INIT;
 
+#ifdef QUIC_UDP_OFFLOAD
+  {
+    int on = 1;
+    qs->gro = !setsockopt(sockfd, IPPROTO_UDP, UDP_GRO, (void *)&on,
+                          sizeof(on));
+  }
+#endif
+
   ngtcp2_addr_init(&path.local, (uint8_t *)&qs->local_addr, qs->local_addrlen,
                    NULL);
   ngtcp2_addr_init(&path.remote, (uint8_t*)addr, addrlen, NULL);
@@ -654,8 +683,10 @@ static int ng_getsock(struct connectdata *conn, curl_socket_t *socks)
      always be ready for one */
   bitmap |= GETSOCK_READSOCK(FIRSTSOCKET);
 
-  /* we're still uploading or the HTTP/2 layer wants to send data */
-  if((k->keepon & (KEEP_SEND|KEEP_SEND_PAUSE)) == KEEP_SEND)
+  /* we're still uploading or the HTTP/2 layer wants to send data, or
+     packets are waiting for the socket to take them */
+  if(((k->keepon & (KEEP_SEND|KEEP_SEND_PAUSE)) == KEEP_SEND) ||
+     (conn->quic && conn->quic->sendlen))
     bitmap |= GETSOCK_WRITESOCK(FIRSTSOCKET);
 
   return bitmap;
@@ -680,6 +711,8 @@ static CURLcode ng_disconnect(struct connectdata *conn,
   nghttp3_conn_del(qs->h3conn);
   ngtcp2_conn_del(qs->qconn);
   SSL_CTX_free(qs->sslctx);
+  for(i = 0; i < 2; i++)
+    Curl_safefree(conn->hequic[i].sendbuf);
   return CURLE_OK;
 }
 
@@ -712,18 +745,35 @@ static const struct Curl_handler Curl_handler_http3 = {
   PROTOPT_SSL | PROTOPT_STREAM          /* flags */
 };
 
+/*
+ * Response data arrived on a stream. When the transfer owning it is not the
+ * one currently reading from the connection, mark it to get it to run soon
+ * and pick up what is stored for it.
+ */
+static void h3_wakeup(struct quicsocket *qs, struct Curl_easy *data)
+{
+  if(data != qs->conn->data) {
+    data->state.drain = 1;
+    Curl_expire(data, 0, EXPIRE_RUN_NOW);
+  }
+}
+
 static int cb_h3_stream_close(nghttp3_conn *conn, int64_t stream_id,
                               uint64_t app_error_code, void *user_data,
                               void *stream_user_data)
 {
   struct Curl_easy *data = stream_user_data;
-  struct HTTP *stream = data->req.protop;
+  struct HTTP *stream;
   (void)conn;
   (void)stream_id;
   (void)app_error_code;
   (void)user_data;
+  if(!data)
+    /* the transfer is already done */
+    return 0;
   H3BUGF(infof(data, "cb_h3_stream_close CALLED\n"));
 
+  stream = data->req.protop;
   stream->closed = TRUE;
   Curl_expire(data, 0, EXPIRE_QUIC);
   /* make sure that ngh3_stream_recv is called again to complete the transfer
@@ -830,17 +880,26 @@ static int cb_h3_recv_data(nghttp3_conn *conn, int64_t stream_id,
                            void *user_data, void *stream_user_data)
 {
   struct Curl_easy *data = stream_user_data;
-  struct HTTP *stream = data->req.protop;
+  struct quicsocket *qs = user_data;
+  struct HTTP *stream;
   CURLcode result = CURLE_OK;
   (void)conn;
+  (void)stream_id;
+
+  if(!data) {
+    /* the transfer is already done, the data goes nowhere but must not use
+       up the connection's flow control window */
+    ngtcp2_conn_extend_max_offset(qs->qconn, buflen);
+    return 0;
+  }
 
+  stream = data->req.protop;
   result = write_data(data, stream, buf, buflen);
   if(result) {
     return -1;
   }
   stream->unacked_window += buflen;
-  (void)stream_id;
-  (void)user_data;
+  h3_wakeup(qs, data);
   return 0;
 }
 
@@ -889,19 +948,23 @@ static int cb_h3_end_headers(nghttp3_conn *conn, int64_t stream_id,
                              void *user_data, void *stream_user_data)
 {
   struct Curl_easy *data = stream_user_data;
-  struct HTTP *stream = data->req.protop;
+  struct HTTP *stream;
   CURLcode result = CURLE_OK;
   (void)conn;
   (void)stream_id;
-  (void)user_data;
+
+  if(!data)
+    return 0;
 
   /* add a CRLF only if we've received some headers */
+  stream = data->req.protop;
   if(stream->firstheader) {
     result = write_data(data, stream, "\r\n", 2);
     if(result) {
       return -1;
     }
   }
+  h3_wakeup(user_data, data);
   return 0;
 }
 
@@ -913,7 +976,7 @@ static int cb_h3_recv_header(nghttp3_conn *conn, int64_t stream_id,
   nghttp3_vec h3name = nghttp3_rcbuf_get_buf(name);
   nghttp3_vec h3val = nghttp3_rcbuf_get_buf(value);
   struct Curl_easy *data = stream_user_data;
-  struct HTTP *stream = data->req.protop;
+  struct HTTP *stream;
   CURLcode result = CURLE_OK;
   (void)conn;
   (void)stream_id;
@@ -921,6 +984,10 @@ static int cb_h3_recv_header(nghttp3_conn *conn, int64_t stream_id,
   (void)flags;
   (void)user_data;
 
+  if(!data)
+    return 0;
+
+  stream = data->req.protop;
   if(h3name.len == sizeof(":status") - 1 &&
      !memcmp(":status", h3name.base, h3name.len)) {
     char line[14]; /* status line is always 13 characters long */
@@ -1134,11 +1201,15 @@ static int cb_h3_acked_stream_data(nghttp3_conn *conn, int64_t stream_id,
                                    void *stream_user_data)
 {
   struct Curl_easy *data = stream_user_data;
-  struct HTTP *stream = data->req.protop;
+  struct HTTP *stream;
   (void)conn;
   (void)stream_id;
   (void)user_data;
 
+  if(!data)
+    return 0;
+
+  stream = data->req.protop;
   if(!data->set.postfields) {
     stream->h3out->used -= datalen;
     H3BUGF(infof(data,
@@ -1156,12 +1227,19 @@ static ssize_t cb_h3_readfunction(nghttp3_conn *conn, int64_t stream_id,
 {
   struct Curl_easy *data = stream_user_data;
   size_t nread;
-  struct HTTP *stream = data->req.protop;
+  struct HTTP *stream;
   (void)conn;
   (void)stream_id;
   (void)user_data;
   (void)veccnt;
 
+  if(!data) {
+    /* the transfer is already done, there's nothing more to send */
+    *pflags = NGHTTP3_DATA_FLAG_EOF;
+    return 0;
+  }
+
+  stream = data->req.protop;
   if(data->set.postfields) {
     vec[0].base = data->set.postfields;
     vec[0].len = data->state.infilesize;
@@ -1242,6 +1320,8 @@ static CURLcode http_request(struct connectdata *conn, const void *mem,
 
   stream->stream3_id = stream3_id;
   stream->h3req = TRUE; /* senf off! */
+  qs->opened_bidi++;
+  qs->active_bidi++;
 
   /* Calculate number of headers contained in [mem, mem + len). Assumes a
      correctly generated HTTP header field block. */
@@ -1534,6 +1614,70 @@ CURLcode Curl_quic_is_connected(struct connectdata *conn,
   return result;
 }
 
+/*
+ * Receive one datagram, or with UDP GRO a train of them that the kernel put
+ * together. '*pktlen' is set to the size of the packets in it, all but the
+ * last one are exactly that large.
+ */
+static ssize_t recv_packets(struct quicsocket *qs, curl_socket_t sockfd,
+                            uint8_t *buf, size_t bufsize,
+                            struct sockaddr_storage *remote_addr,
+                            socklen_t *remote_addrlen, size_t *pktlen)
+{
+  ssize_t recvd;
+
+#ifdef QUIC_UDP_OFFLOAD
+  if(qs->gro) {
+    struct iovec iov;
+    struct msghdr msg;
+    union {
+      char buf[CMSG_SPACE(sizeof(int))];
+      struct cmsghdr align;
+    } ctrl;
+    struct cmsghdr *cmsg;
+
+    iov.iov_base = buf;
+    iov.iov_len = bufsize;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_name = remote_addr;
+    msg.msg_namelen = *remote_addrlen;
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+
+    while((recvd = recvmsg(sockfd, &msg, 0)) == -1 &&
+          SOCKERRNO == EINTR)
+      ;
+    if(recvd == -1)
+      return -1;
+
+    *remote_addrlen = msg.msg_namelen;
+    *pktlen = (size_t)recvd;
+    for(cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+      if((cmsg->cmsg_level == IPPROTO_UDP) && (cmsg->cmsg_type == UDP_GRO)) {
+        int segsize;
+        memcpy(&segsize, CMSG_DATA(cmsg), sizeof(segsize));
+        if(segsize > 0)
+          *pktlen = (size_t)segsize;
+      }
+    }
+    return recvd;
+  }
+#else
+  (void)qs;
+#endif
+
+  while((recvd = recvfrom(sockfd, buf, bufsize, 0,
+                          (struct sockaddr *)remote_addr,
+                          remote_addrlen)) == -1 &&
+        SOCKERRNO == EINTR)
+    ;
+  if(recvd != -1)
+    *pktlen = (size_t)recvd;
+  return recvd;
+}
+
 static CURLcode ng_process_ingress(struct connectdata *conn, int sockfd,
                                    struct quicsocket *qs)
 {
@@ -1545,14 +1689,13 @@ static CURLcode ng_process_ingress(struct connectdata *conn, int sockfd,
   socklen_t remote_addrlen;
   ngtcp2_path path;
   ngtcp2_tstamp ts = timestamp();
+  size_t pktlen = 0;
+  size_t offset;
 
   for(;;) {
     remote_addrlen = sizeof(remote_addr);
-    while((recvd = recvfrom(sockfd, buf, bufsize, 0,
-                            (struct sockaddr *)&remote_addr,
-                            &remote_addrlen)) == -1 &&
-          SOCKERRNO == EINTR)
-      ;
+    recvd = recv_packets(qs, sockfd, buf, bufsize, &remote_addr,
+                         &remote_addrlen, &pktlen);
     if(recvd == -1) {
       if(SOCKERRNO == EAGAIN || SOCKERRNO == EWOULDBLOCK)
         break;
@@ -1566,23 +1709,135 @@ static CURLcode ng_process_ingress(struct connectdata *conn, int sockfd,
     ngtcp2_addr_init(&path.remote, (uint8_t *)&remote_addr, remote_addrlen,
                      NULL);
 
-    rv = ngtcp2_conn_read_pkt(qs->qconn, &path, buf, recvd, ts);
-    if(rv != 0) {
-      /* TODO Send CONNECTION_CLOSE if possible */
-      return CURLE_RECV_ERROR;
+    for(offset = 0; offset < (size_t)recvd; offset += pktlen) {
+      size_t len = CURLMIN(pktlen, (size_t)recvd - offset);
+      rv = ngtcp2_conn_read_pkt(qs->qconn, &path, buf + offset, len, ts);
+      if(rv != 0) {
+        /* TODO Send CONNECTION_CLOSE if possible */
+        return CURLE_RECV_ERROR;
+      }
     }
   }
 
   return CURLE_OK;
 }
 
+/*
+ * Send the 'len' bytes of packets in 'buf', all but the last one are
+ * 'gsolen' bytes. With UDP GSO the kernel cuts them apart from a single
+ * call, otherwise they are sent one by one. '*psent' is set to the number of
+ * bytes of the packets that went out, also when CURLE_AGAIN is returned.
+ */
+static CURLcode send_packets(struct connectdata *conn, curl_socket_t sockfd,
+                             struct quicsocket *qs,
+                             const uint8_t *buf, size_t len, size_t gsolen,
+                             size_t *psent)
+{
+  ssize_t sent;
+
+  *psent = 0;
+#ifdef QUIC_UDP_OFFLOAD
+  if(!qs->no_gso && (len > gsolen)) {
+    struct iovec iov;
+    struct msghdr msg;
+    union {
+      char buf[CMSG_SPACE(sizeof(uint16_t))];
+      struct cmsghdr align;
+    } ctrl;
+    struct cmsghdr *cmsg;
+    uint16_t segsize = (uint16_t)gsolen;
+
+    iov.iov_base = (void *)buf;
+    iov.iov_len = len;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = ctrl.buf;
+    msg.msg_controllen = sizeof(ctrl.buf);
+    cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = IPPROTO_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(segsize));
+    memcpy(CMSG_DATA(cmsg), &segsize, sizeof(segsize));
+
+    while((sent = sendmsg(sockfd, &msg, 0)) == -1 &&
+          SOCKERRNO == EINTR)
+      ;
+    if(sent != -1) {
+      *psent = len;
+      return CURLE_OK;
+    }
+    if(SOCKERRNO == EAGAIN || SOCKERRNO == EWOULDBLOCK)
+      return CURLE_AGAIN;
+    if(SOCKERRNO != EIO && SOCKERRNO != EINVAL) {
+      failf(conn->data, "sendmsg() returned %zd (errno %d)\n", sent,
+            SOCKERRNO);
+      return CURLE_SEND_ERROR;
+    }
+    /* the kernel or the network interface cannot do it */
+    infof(conn->data, "ngtcp2: UDP GSO not available (errno %d)\n",
+          SOCKERRNO);
+    qs->no_gso = TRUE;
+  }
+#else
+  (void)qs;
+#endif
+
+  while(len) {
+    size_t pktlen = CURLMIN(gsolen, len);
+    while((sent = send(sockfd, buf, pktlen, 0)) == -1 &&
+          SOCKERRNO == EINTR)
+      ;
+    if(sent == -1) {
+      if(SOCKERRNO == EAGAIN || SOCKERRNO == EWOULDBLOCK)
+        return CURLE_AGAIN;
+      failf(conn->data, "send() returned %zd (errno %d)\n", sent,
+            SOCKERRNO);
+      return CURLE_SEND_ERROR;
+    }
+    buf += pktlen;
+    len -= pktlen;
+    *psent += pktlen;
+  }
+  return CURLE_OK;
+}
+
+/*
+ * Send the batch of packets lined up in qs->sendbuf, that is all of them but
+ * the 'sendtail' bytes at the end. What the socket does not take stays at
+ * the start of the buffer for the next call.
+ */
+static CURLcode send_batch(struct connectdata *conn, curl_socket_t sockfd,
+                           struct quicsocket *qs)
+{
+  size_t sent;
+  CURLcode result = send_packets(conn, sockfd, qs, qs->sendbuf,
+                                 qs->sendlen - qs->sendtail, qs->sendgso,
+                                 &sent);
+  if(sent) {
+    memmove(qs->sendbuf, qs->sendbuf + sent, qs->sendlen - sent);
+    qs->sendlen -= sent;
+  }
+  if(!result)
+    qs->sendnpkts = 0;
+  return result;
+}
+
+/*
+ * Packets are lined up in qs->sendbuf and sent together, as long as they are
+ * all as large as the first one. A smaller one is the last of its batch, a
+ * larger one starts a new batch.
+ *
+ * Packets the socket does not take are kept, and sent before anything else
+ * on the next call. ngtcp2 is not asked for more packets until they are
+ * gone, and the socket is waited on for writing meanwhile.
+ */
 static CURLcode ng_flush_egress(struct connectdata *conn, int sockfd,
                                 struct quicsocket *qs)
 {
   int rv;
-  ssize_t sent;
+  CURLcode result = CURLE_OK;
   ssize_t outlen;
-  uint8_t out[NGTCP2_MAX_PKTLEN_IPV4];
   size_t pktlen;
   ngtcp2_path_storage ps;
   ngtcp2_tstamp ts = timestamp();
@@ -1606,6 +1861,13 @@ static CURLcode ng_flush_egress(struct connectdata *conn, int sockfd,
     assert(0);
   }
 
+  if(!qs->sendbuf) {
+    /* a full batch and the larger packet that ended it */
+    qs->sendbuf = malloc((QUIC_SEND_BATCH + 1) * pktlen);
+    if(!qs->sendbuf)
+      return CURLE_OUT_OF_MEMORY;
+  }
+
   rv = ngtcp2_conn_handle_expiry(qs->qconn, ts);
   if(rv != 0) {
     failf(conn->data, "ngtcp2_conn_handle_expiry returned error: %s\n",
@@ -1613,9 +1875,23 @@ static CURLcode ng_flush_egress(struct connectdata *conn, int sockfd,
     return CURLE_SEND_ERROR;
   }
 
+  if(qs->sendlen) {
+    /* packets kept from the previous call */
+    result = send_batch(conn, sockfd, qs);
+    if(!result && qs->sendtail) {
+      /* the larger packet left starts a new batch */
+      qs->sendgso = qs->sendtail;
+      qs->sendnpkts = 1;
+      qs->sendtail = 0;
+    }
+    else if(result && (result != CURLE_AGAIN))
+      return result;
+  }
+
   ngtcp2_path_storage_zero(&ps);
 
-  for(;;) {
+  while(!result) {
+    uint8_t *out = qs->sendbuf + qs->sendlen;
     outlen = -1;
     if(qs->h3conn && ngtcp2_conn_get_max_data_left(qs->qconn)) {
       veccnt = nghttp3_conn_writev_stream(qs->h3conn, &stream_id, &fin, vec,
@@ -1688,23 +1964,30 @@ static CURLcode ng_flush_egress(struct connectdata *conn, int sockfd,
     }
 
     memcpy(&remote_addr, ps.path.remote.addr, ps.path.remote.addrlen);
-    while((sent = send(sockfd, out, outlen, 0)) == -1 &&
-          SOCKERRNO == EINTR)
-      ;
 
-    if(sent == -1) {
-      if(SOCKERRNO == EAGAIN || SOCKERRNO == EWOULDBLOCK) {
-        /* TODO Cache packet */
+    qs->sendlen += outlen;
+    if(qs->sendnpkts && ((size_t)outlen > qs->sendgso)) {
+      /* too large to go with the ones before it, which go first */
+      qs->sendtail = outlen;
+      result = send_batch(conn, sockfd, qs);
+      if(result)
         break;
-      }
-      else {
-        failf(conn->data, "send() returned %zd (errno %d)\n", sent,
-              SOCKERRNO);
-        return CURLE_SEND_ERROR;
-      }
+      qs->sendtail = 0;
     }
+    if(!qs->sendnpkts)
+      qs->sendgso = outlen;
+    qs->sendnpkts++;
+
+    if(((size_t)outlen < qs->sendgso) ||
+       (qs->sendnpkts == QUIC_SEND_BATCH))
+      result = send_batch(conn, sockfd, qs);
   }
 
+  if(!result && qs->sendlen)
+    result = send_batch(conn, sockfd, qs);
+  if(result && (result != CURLE_AGAIN))
+    return result;
+
   expiry = ngtcp2_conn_get_expiry(qs->qconn);
   if(expiry != UINT64_MAX) {
     if(expiry <= ts) {
@@ -1740,14 +2023,35 @@ CURLcode Curl_quic_done_sending(struct connectdata *conn)
  */
 void Curl_quic_done(struct Curl_easy *data, bool premature)
 {
-  (void)premature;
   if(data->conn->handler == &Curl_handler_http3) {
     /* only for HTTP/3 transfers */
     struct HTTP *stream = data->req.protop;
+    struct quicsocket *qs = data->conn->quic;
+    if(stream->h3req && !stream->closed) {
+      /* the connection lives on with other transfers, so the stream must
+         not point to this transfer anymore */
+      if(premature)
+        ngtcp2_conn_shutdown_stream(qs->qconn, stream->stream3_id,
+                                    H3_REQUEST_CANCELLED);
+      nghttp3_conn_set_stream_user_data(qs->h3conn, stream->stream3_id,
+                                        NULL);
+    }
     Curl_safefree(stream->overflow_buf);
   }
 }
 
+/*
+ * Returns how many transfers can use the connection at the same time: the
+ * ones with a stream open and as many more as the server allows us to open.
+ */
+size_t Curl_quic_max_streams(struct connectdata *conn)
+{
+  struct quicsocket *qs = conn->quic;
+  if(qs->max_bidi_streams <= qs->opened_bidi)
+    return qs->active_bidi;
+  return (size_t)(qs->max_bidi_streams - qs->opened_bidi) + qs->active_bidi;
+}
+
 /*
  * Called from transfer.c:data_pending to know if we should keep looping
  * to receive more data from the connection.
@@ -51,6 +51,18 @@ struct quicsocket {
   uint8_t tls_alert;
   struct sockaddr_storage local_addr;
   socklen_t local_addrlen;
+  bool gro;    /* received packets may come coalesced (UDP GRO) */
+  bool no_gso; /* sending with UDP GSO failed, send packets one by one */
+  /* packets written by ngtcp2 and not sent yet, see ng_flush_egress() */
+  uint8_t *sendbuf;
+  size_t sendlen;   /* bytes of packets in sendbuf */
+  size_t sendnpkts; /* packets in the batch being lined up */
+  size_t sendgso;   /* size of each packet of that batch but the last */
+  size_t sendtail;  /* bytes at the end of sendlen that are a larger packet
+                       sent after the batch */
+  uint64_t max_bidi_streams; /* request streams the server lets us open */
+  uint64_t opened_bidi; /* request streams opened so far */
+  size_t active_bidi; /* request streams currently open */
 
   nghttp3_conn *h3conn;
   nghttp3_conn_settings h3settings;
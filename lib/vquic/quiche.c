@@ -49,6 +49,7 @@
 #endif
 
 #define QUIC_MAX_STREAMS (256*1024)
+#define H3_MAX_STREAMS 100 /* concurrent requests we make on a connection */
 #define QUIC_MAX_DATA (1*1024*1024)
 #define QUIC_IDLE_TIMEOUT (60 * 1000) /* milliseconds */
 
@@ -361,118 +362,164 @@ static CURLcode flush_egress(struct connectdata *conn, int sockfd,
   return CURLE_OK;
 }
 
-struct h3h1header {
-  char *dest;
-  size_t destlen; /* left to use */
-  size_t nlen; /* used */
-};
-
 static int cb_each_header(uint8_t *name, size_t name_len,
                           uint8_t *value, size_t value_len,
                           void *argp)
 {
-  struct h3h1header *headers = (struct h3h1header *)argp;
-  size_t olen = 0;
+  Curl_send_buffer **headers = (Curl_send_buffer **)argp;
+  CURLcode result;
 
-  if((name_len == 7) && !strncmp(":status", (char *)name, 7)) {
-    msnprintf(headers->dest,
-              headers->destlen, "HTTP/3 %.*s\n",
-              (int) value_len, value);
-  }
-  else if(!headers->nlen) {
+  if(!*headers)
+    /* freed by a previous failure */
+    return CURLE_OUT_OF_MEMORY;
+  if((name_len == 7) && !strncmp(":status", (char *)name, 7))
+    result = Curl_add_bufferf(headers, "HTTP/3 %.*s\n",
+                              (int) value_len, value);
+  else if(!(*headers)->size_used)
     return CURLE_HTTP3;
+  else
+    result = Curl_add_bufferf(headers, "%.*s: %.*s\n",
+                              (int)name_len, name, (int) value_len, value);
+  return (int)result;
+}
+
+/*
+ * Find the transfer that sent its request on the given stream.
+ */
+static struct Curl_easy *h3_stream_data(struct connectdata *conn,
+                                        int64_t stream3_id)
+{
+  struct curl_llist_element *e;
+  for(e = conn->easyq.head; e; e = e->next) {
+    struct Curl_easy *data = e->ptr;
+    struct HTTP *stream = data->req.protop;
+    if(stream && stream->h3req && (stream->stream3_id == stream3_id))
+      return data;
   }
-  else {
-    msnprintf(headers->dest,
-              headers->destlen, "%.*s: %.*s\n",
-              (int)name_len, name, (int) value_len, value);
-  }
-  olen = strlen(headers->dest);
-  headers->destlen -= olen;
-  headers->nlen += olen;
-  headers->dest += olen;
-  return 0;
+  return NULL;
 }
 
-static ssize_t h3_stream_recv(struct connectdata *conn,
-                              int sockindex,
-                              char *buf,
-                              size_t buffersize,
-                              CURLcode *curlcode)
+/*
+ * Poll all events off the HTTP/3 connection and note them with the stream
+ * of the transfer they are for. Response headers are stored, body data is
+ * left in quiche until that transfer reads it. Transfers other than the one
+ * currently reading are made to run soon to pick up what is there for them.
+ */
+static CURLcode h3_process_events(struct connectdata *conn,
+                                  struct quicsocket *qs)
 {
-  ssize_t recvd = -1;
-  ssize_t rcode;
-  struct quicsocket *qs = conn->quic;
-  curl_socket_t sockfd = conn->sock[sockindex];
+  CURLcode result = CURLE_OK;
   quiche_h3_event *ev;
-  int rc;
-  struct h3h1header headers;
-  struct Curl_easy *data = conn->data;
-  struct HTTP *stream = data->req.protop;
-  headers.dest = buf;
-  headers.destlen = buffersize;
-  headers.nlen = 0;
-
-  if(process_ingress(conn, sockfd, qs)) {
-    infof(data, "h3_stream_recv returns on ingress\n");
-    *curlcode = CURLE_RECV_ERROR;
-    return -1;
-  }
 
-  while(recvd < 0) {
+  while(!result) {
+    struct Curl_easy *data;
+    struct HTTP *stream;
     int64_t s = quiche_h3_conn_poll(qs->h3c, qs->conn, &ev);
     if(s < 0)
       /* nothing more to do */
       break;
 
-    if(s != stream->stream3_id) {
-      /* another transfer, ignore for now */
-      infof(data, "Got h3 for stream %u, expects %u\n",
-            s, stream->stream3_id);
+    data = h3_stream_data(conn, s);
+    if(!data) {
+      /* no transfer wants this stream (anymore) */
+      H3BUGF(infof(conn->data, "Got h3 for unknown stream %u\n", s));
+      quiche_h3_event_free(ev);
       continue;
     }
+    stream = data->req.protop;
 
     switch(quiche_h3_event_type(ev)) {
     case QUICHE_H3_EVENT_HEADERS:
-      rc = quiche_h3_event_for_each_header(ev, cb_each_header, &headers);
-      if(rc) {
-        *curlcode = rc;
+      if(stream->firstheader)
+        /* trailers, ignored */
+        break;
+      if(!stream->h3_recvbuf) {
+        stream->h3_recvbuf = Curl_add_buffer_init();
+        if(!stream->h3_recvbuf) {
+          result = CURLE_OUT_OF_MEMORY;
+          break;
+        }
+      }
+      if(quiche_h3_event_for_each_header(ev, cb_each_header,
+                                         &stream->h3_recvbuf) ||
+         Curl_add_buffer(&stream->h3_recvbuf, "\r\n", 2)) {
         failf(data, "Error in HTTP/3 response header");
+        result = CURLE_HTTP3;
         break;
       }
-      recvd = headers.nlen;
+      stream->firstheader = TRUE;
       break;
     case QUICHE_H3_EVENT_DATA:
-      if(!stream->firstbody) {
-        /* add a header-body separator CRLF */
-        buf[0] = '\r';
-        buf[1] = '\n';
-        buf += 2;
-        buffersize -= 2;
-        stream->firstbody = TRUE;
-        recvd = 2; /* two bytes already */
-      }
-      else
-        recvd = 0;
-      rcode = quiche_h3_recv_body(qs->h3c, qs->conn, s, (unsigned char *)buf,
-                                  buffersize);
-      if(rcode <= 0) {
-        recvd = -1;
-        break;
-      }
-      recvd += rcode;
+      stream->h3_data = TRUE;
       break;
-
     case QUICHE_H3_EVENT_FINISHED:
-      streamclose(conn, "End of stream");
-      recvd = 0; /* end of stream */
+      stream->h3_fin = TRUE;
       break;
     default:
       break;
     }
 
+    if(data != conn->data) {
+      data->state.drain = 1;
+      Curl_expire(data, 0, EXPIRE_RUN_NOW);
+    }
     quiche_h3_event_free(ev);
   }
+  return result;
+}
+
+static ssize_t h3_stream_recv(struct connectdata *conn,
+                              int sockindex,
+                              char *buf,
+                              size_t buffersize,
+                              CURLcode *curlcode)
+{
+  ssize_t recvd = -1;
+  ssize_t rcode;
+  struct quicsocket *qs = conn->quic;
+  curl_socket_t sockfd = conn->sock[sockindex];
+  struct Curl_easy *data = conn->data;
+  struct HTTP *stream = data->req.protop;
+  Curl_send_buffer *headers;
+
+  if(process_ingress(conn, sockfd, qs)) {
+    infof(data, "h3_stream_recv returns on ingress\n");
+    *curlcode = CURLE_RECV_ERROR;
+    return -1;
+  }
+
+  *curlcode = h3_process_events(conn, qs);
+  if(*curlcode)
+    return -1;
+
+  headers = stream->h3_recvbuf;
+  if(headers && (stream->nread_h3_recvbuf < headers->size_used)) {
+    size_t ncopy = CURLMIN(buffersize,
+                           headers->size_used - stream->nread_h3_recvbuf);
+    memcpy(buf, headers->buffer + stream->nread_h3_recvbuf, ncopy);
+    stream->nread_h3_recvbuf += ncopy;
+    recvd = (ssize_t)ncopy;
+  }
+  else {
+    while(stream->h3_data) {
+      rcode = quiche_h3_recv_body(qs->h3c, qs->conn, stream->stream3_id,
+                                  (unsigned char *)buf, buffersize);
+      if(rcode > 0) {
+        recvd = rcode;
+        break;
+      }
+      /* all there was has been read, which may let quiche tell about more
+         data or the end of the stream */
+      stream->h3_data = FALSE;
+      *curlcode = h3_process_events(conn, qs);
+      if(*curlcode)
+        return -1;
+    }
+  }
+
+  if((recvd < 0) && stream->h3_fin && !stream->h3_data)
+    recvd = 0; /* end of stream */
+
   if(flush_egress(conn, sockfd, qs)) {
     *curlcode = CURLE_SEND_ERROR;
     return -1;
@@ -790,8 +837,23 @@ CURLcode Curl_quic_done_sending(struct connectdata *conn)
  */
 void Curl_quic_done(struct Curl_easy *data, bool premature)
 {
-  (void)data;
   (void)premature;
+  if(data->conn->handler == &Curl_handler_http3) {
+    /* only for HTTP/3 transfers */
+    struct HTTP *stream = data->req.protop;
+    Curl_add_buffer_free(&stream->h3_recvbuf);
+  }
+}
+
+/*
+ * Returns how many transfers can use the connection at the same time. quiche
+ * does not tell how many streams the server allows us to open, so assume the
+ * 100 that servers are recommended to allow at least.
+ */
+size_t Curl_quic_max_streams(struct connectdata *conn)
+{
+  (void)conn;
+  return H3_MAX_STREAMS;
 }
 
 /*
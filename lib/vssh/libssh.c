@@ -1212,7 +1212,7 @@ static CURLcode myssh_statemach_act(struct connectdata *conn, bool *block)
       /* we want to use the _sending_ function even when the socket turns
          out readable as the underlying libssh sftp send function will deal
          with both accordingly */
-      conn->cselect_bits = CURL_CSELECT_OUT;
+      conn->data->state.select_bits = CURL_CSELECT_OUT;
 
       /* since we don't really wait for anything at this point, we want the
          state machine to move on as soon as possible so we set a very short
@@ -1616,7 +1616,7 @@ static CURLcode myssh_statemach_act(struct connectdata *conn, bool *block)
     /* we want to use the _receiving_ function even when the socket turns
        out writableable as the underlying libssh recv function will deal
        with both accordingly */
-    conn->cselect_bits = CURL_CSELECT_IN;
+    conn->data->state.select_bits = CURL_CSELECT_IN;
 
     if(result) {
       /* this should never occur; the close state should be entered
@@ -1742,7 +1742,7 @@ static CURLcode myssh_statemach_act(struct connectdata *conn, bool *block)
       /* we want to use the _sending_ function even when the socket turns
          out readable as the underlying libssh scp send function will deal
          with both accordingly */
-      conn->cselect_bits = CURL_CSELECT_OUT;
+      conn->data->state.select_bits = CURL_CSELECT_OUT;
 
       state(conn, SSH_STOP);
 
@@ -1781,7 +1781,7 @@ static CURLcode myssh_statemach_act(struct connectdata *conn, bool *block)
         /* we want to use the _receiving_ function even when the socket turns
            out writableable as the underlying libssh recv function will deal
            with both accordingly */
-        conn->cselect_bits = CURL_CSELECT_IN;
+        conn->data->state.select_bits = CURL_CSELECT_IN;
 
         state(conn, SSH_STOP);
         break;
@@ -1844,7 +1844,7 @@ static CURLcode ssh_statemach_act(struct connectdata *conn, bool *block)
         /* we want to use the _sending_ function even when the socket turns
            out readable as the underlying libssh2 sftp send function will deal
            with both accordingly */
-        conn->cselect_bits = CURL_CSELECT_OUT;
+        conn->data->state.select_bits = CURL_CSELECT_OUT;
 
         /* since we don't really wait for anything at this point, we want the
            state machine to move on as soon as possible so we set a very short
@@ -2277,7 +2277,7 @@ static CURLcode ssh_statemach_act(struct connectdata *conn, bool *block)
     /* we want to use the _receiving_ function even when the socket turns
        out writableable as the underlying libssh2 recv function will deal
        with both accordingly */
-    conn->cselect_bits = CURL_CSELECT_IN;
+    conn->data->state.select_bits = CURL_CSELECT_IN;
 
     if(result) {
       /* this should never occur; the close state should be entered
@@ -2430,7 +2430,7 @@ static CURLcode ssh_statemach_act(struct connectdata *conn, bool *block)
         /* we want to use the _sending_ function even when the socket turns
            out readable as the underlying libssh2 scp send function will deal
            with both accordingly */
-        conn->cselect_bits = CURL_CSELECT_OUT;
+        conn->data->state.select_bits = CURL_CSELECT_OUT;
 
         state(conn, SSH_STOP);
       }
@@ -2492,7 +2492,7 @@ static CURLcode ssh_statemach_act(struct connectdata *conn, bool *block)
       /* we want to use the _receiving_ function even when the socket turns
          out writableable as the underlying libssh2 recv function will deal
          with both accordingly */
-      conn->cselect_bits = CURL_CSELECT_IN;
+      conn->data->state.select_bits = CURL_CSELECT_IN;
 
       if(result) {
         state(conn, SSH_SCP_CHANNEL_FREE);
@@ -855,12 +855,16 @@ const struct Curl_ssl Curl_ssl_bearssl = {
   Curl_bearssl_close,
   Curl_none_close_all,
   Curl_bearssl_session_free,
+  NULL,
+  NULL,
   Curl_none_set_engine,
   Curl_none_set_engine_default,
   Curl_none_engines_list,
   Curl_none_false_start,
   Curl_bearssl_md5sum,
-  Curl_bearssl_sha256sum
+  Curl_bearssl_sha256sum,
+  NULL,
+  NULL
 };
 
 #endif /* USE_BEARSSL */
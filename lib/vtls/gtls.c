@@ -1750,6 +1750,37 @@ static void Curl_gtls_session_free(void *ptr)
   free(ptr);
 }
 
+/*
+ * The cached session already is the blob from gnutls_session_get_data(), so
+ * exporting and importing it is just a copy.
+ */
+static CURLcode Curl_gtls_session_export(void *sessionid, size_t idsize,
+                                         unsigned char **blob,
+                                         size_t *bloblen)
+{
+  if(!idsize)
+    return CURLE_SSL_CONNECT_ERROR;
+  *blob = malloc(idsize);
+  if(!*blob)
+    return CURLE_OUT_OF_MEMORY;
+  memcpy(*blob, sessionid, idsize);
+  *bloblen = idsize;
+  return CURLE_OK;
+}
+
+static CURLcode Curl_gtls_session_import(const unsigned char *blob,
+                                         size_t bloblen, void **sessionid,
+                                         size_t *idsize)
+{
+  void *copy = malloc(bloblen);
+  if(!copy)
+    return CURLE_OUT_OF_MEMORY;
+  memcpy(copy, blob, bloblen);
+  *sessionid = copy;
+  *idsize = bloblen;
+  return CURLE_OK;
+}
+
 static size_t Curl_gtls_version(char *buffer, size_t size)
 {
   return msnprintf(buffer, size, "GnuTLS/%s", gnutls_check_version(NULL));
@@ -1870,12 +1901,16 @@ const struct Curl_ssl Curl_ssl_gnutls = {
   Curl_gtls_close,               /* close_one */
   Curl_none_close_all,           /* close_all */
   Curl_gtls_session_free,        /* session_free */
+  Curl_gtls_session_export,      /* session_export */
+  Curl_gtls_session_import,      /* session_import */
   Curl_none_set_engine,          /* set_engine */
   Curl_none_set_engine_default,  /* set_engine_default */
   Curl_none_engines_list,        /* engines_list */
   Curl_none_false_start,         /* false_start */
   Curl_gtls_md5sum,              /* md5sum */
-  Curl_gtls_sha256sum            /* sha256sum */
+  Curl_gtls_sha256sum,           /* sha256sum */
+  NULL,                          /* free_multi_ssl_backend_data */
+  NULL                           /* peer_cert_matches */
 };
 
 #endif /* USE_GNUTLS */
@@ -1078,12 +1078,16 @@ const struct Curl_ssl Curl_ssl_mbedtls = {
   Curl_mbedtls_close,               /* close_one */
   Curl_mbedtls_close_all,           /* close_all */
   Curl_mbedtls_session_free,        /* session_free */
+  NULL,                             /* session_export */
+  NULL,                             /* session_import */
   Curl_none_set_engine,             /* set_engine */
   Curl_none_set_engine_default,     /* set_engine_default */
   Curl_none_engines_list,           /* engines_list */
   Curl_none_false_start,            /* false_start */
   Curl_none_md5sum,                 /* md5sum */
-  Curl_mbedtls_sha256sum            /* sha256sum */
+  Curl_mbedtls_sha256sum,           /* sha256sum */
+  NULL,                             /* free_multi_ssl_backend_data */
+  NULL                              /* peer_cert_matches */
 };
 
 #endif /* USE_MBEDTLS */
@@ -31,6 +31,10 @@
 
 #include <limits.h>
 
+#ifdef HAVE_SYS_STAT_H
+#include <sys/stat.h>
+#endif
+
 #include "urldata.h"
 #include "sendf.h"
 #include "formdata.h" /* for the boundary function */
@@ -121,6 +125,7 @@
 #define HAVE_X509_GET0_EXTENSIONS 1 /* added in 1.1.0 -pre1 */
 #define HAVE_OPAQUE_EVP_PKEY 1 /* since 1.1.0 -pre3 */
 #define HAVE_OPAQUE_RSA_DSA_DH 1 /* since 1.1.0 -pre5 */
+#define HAVE_X509_STORE_UP_REF 1 /* since 1.1.0 */
 #define CONST_EXTS const
 #define HAVE_ERR_REMOVE_THREAD_STATE_DEPRECATED 1
 
@@ -176,7 +181,7 @@
 #define HAVE_KEYLOG_CALLBACK
 #endif
 
-/* Whether SSL_CTX_set_ciphersuites is available.
+/* Whether SSL_CTX_set_ciphersuites and SSL_write_early_data are available.
  * OpenSSL: supported since 1.1.1 (commit a53b5be6a05)
  * BoringSSL: no
  * LibreSSL: no
@@ -186,6 +191,44 @@
      !defined(OPENSSL_IS_BORINGSSL))
 #define HAVE_SSL_CTX_SET_CIPHERSUITES
 #define HAVE_SSL_CTX_SET_POST_HANDSHAKE_AUTH
+#define HAVE_SSL_WRITE_EARLY_DATA
+#endif
+
+/* Whether SSL_has_pending is available, which also counts the read-ahead
+ * data that has not been processed yet.
+ * OpenSSL: supported since 1.1.0
+ * LibreSSL: no
+ */
+#if (OPENSSL_VERSION_NUMBER >= 0x10100000L) && \
+  !defined(LIBRESSL_VERSION_NUMBER)
+#define HAVE_SSL_HAS_PENDING
+/* the size of the buffer to read records into with read-ahead */
+#define OSSL_READ_BUFFER_LEN (64 * 1024)
+#define ossl_pending(x) SSL_has_pending(x)
+/* protocols that get no read-ahead, see ossl_connect_step3() */
+#define OSSL_PINGPONG_PROTOCOLS (PROTO_FAMILY_FTP | PROTO_FAMILY_POP3 | \
+                                 PROTO_FAMILY_SMTP | CURLPROTO_IMAP |   \
+                                 CURLPROTO_IMAPS)
+#else
+#define ossl_pending(x) SSL_pending(x)
+#endif
+
+/* Whether X509_check_host is available.
+ * OpenSSL: supported since 1.0.2
+ * LibreSSL: supported since 2.5.0
+ */
+#if ((OPENSSL_VERSION_NUMBER >= 0x10002000L) && \
+     !defined(LIBRESSL_VERSION_NUMBER)) || \
+  (defined(LIBRESSL_VERSION_NUMBER) && \
+   (LIBRESSL_VERSION_NUMBER >= 0x2050000fL))
+#define HAVE_X509_CHECK_HOST
+#endif
+
+/* Whether record encryption can be offloaded to the kernel (kTLS).
+ * OpenSSL: supported since 3.0.0, when not built with no-ktls
+ */
+#if defined(SSL_OP_ENABLE_KTLS) && !defined(OPENSSL_NO_KTLS)
+#define HAVE_KTLS
 #endif
 
 #if defined(LIBRESSL_VERSION_NUMBER)
@@ -226,6 +269,14 @@ struct ssl_backend_data {
   /* tap_state holds the last seen master key if we're logging them */
   ssl_tap_state_t tap_state;
 #endif
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+  char *early_data;       /* copy of the data sent as early data, to send it
+                             again if the server rejects it */
+  size_t early_len;       /* length of early_data */
+  size_t early_sent;      /* how much of it has been sent again */
+  size_t early_max;       /* the most early data the session allows */
+  bool early_pending;     /* the handshake is not complete yet */
+#endif
 };
 
 #define BACKEND connssl->backend
@@ -1283,6 +1334,11 @@ static void ossl_close(struct ssl_connect_data *connssl)
     SSL_CTX_free(BACKEND->ctx);
     BACKEND->ctx = NULL;
   }
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+  Curl_safefree(BACKEND->early_data);
+  BACKEND->early_len = 0;
+  BACKEND->early_pending = FALSE;
+#endif
 }
 
 /*
@@ -1404,6 +1460,51 @@ static void Curl_ossl_session_free(void *ptr)
   SSL_SESSION_free(ptr);
 }
 
+/*
+ * Serialize a session to DER so that it can be saved to a file.
+ */
+static CURLcode Curl_ossl_session_export(void *sessionid, size_t idsize,
+                                         unsigned char **blob,
+                                         size_t *bloblen)
+{
+  unsigned char *p;
+  int len = i2d_SSL_SESSION(sessionid, NULL);
+  (void)idsize;
+
+  if(len <= 0)
+    return CURLE_SSL_CONNECT_ERROR;
+  *blob = p = malloc((size_t)len);
+  if(!p)
+    return CURLE_OUT_OF_MEMORY;
+  /* i2d_SSL_SESSION advances p */
+  if(i2d_SSL_SESSION(sessionid, &p) != len) {
+    Curl_safefree(*blob);
+    return CURLE_SSL_CONNECT_ERROR;
+  }
+  *bloblen = (size_t)len;
+  return CURLE_OK;
+}
+
+/*
+ * Create a session from DER made by Curl_ossl_session_export().
+ */
+static CURLcode Curl_ossl_session_import(const unsigned char *blob,
+                                         size_t bloblen, void **sessionid,
+                                         size_t *idsize)
+{
+  const unsigned char *p = blob;
+  SSL_SESSION *session;
+
+  if(bloblen > INT_MAX)
+    return CURLE_BAD_CONTENT_ENCODING;
+  session = d2i_SSL_SESSION(NULL, &p, (long)bloblen);
+  if(!session)
+    return CURLE_BAD_CONTENT_ENCODING;
+  *sessionid = session;
+  *idsize = 0;
+  return CURLE_OK;
+}
+
 /*
  * This function is called when the 'data' struct is going away. Close
  * down everything and free all resources!
@@ -2386,6 +2487,304 @@ static int ossl_new_session_cb(SSL *ssl, SSL_SESSION *ssl_sessionid)
   return res;
 }
 
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+/*
+ * When resuming a TLS 1.3 session that allows early data, a safe request can
+ * be sent along with the ClientHello instead of one round trip later. The
+ * early data must use the protocol the session negotiated with ALPN, so it is
+ * only done for HTTP/1.1 sessions and this connection then offers nothing
+ * else.
+ */
+static void ossl_early_data_setup(struct connectdata *conn, int sockindex,
+                                  SSL_SESSION *session)
+{
+  struct Curl_easy *data = conn->data;
+  struct ssl_connect_data *connssl = &conn->ssl[sockindex];
+  const unsigned char *alpn;
+  size_t alpnlen;
+  static const unsigned char http11[] = {
+    ALPN_HTTP_1_1_LENGTH, 'h', 't', 't', 'p', '/', '1', '.', '1'
+  };
+
+  if(!data->set.ssl.earlydata || SSL_IS_PROXY() ||
+     (sockindex != FIRSTSOCKET) ||
+     !(conn->handler->protocol & CURLPROTO_HTTPS) ||
+     ((data->set.httpreq != HTTPREQ_GET) &&
+      (data->set.httpreq != HTTPREQ_HEAD)) || data->set.upload ||
+     data->set.str[STRING_CUSTOMREQUEST] ||
+     (data->set.httpversion == CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE) ||
+     !SSL_SESSION_get_max_early_data(session))
+    return;
+
+  SSL_SESSION_get0_alpn_selected(session, &alpn, &alpnlen);
+  if(alpnlen && ((alpnlen != ALPN_HTTP_1_1_LENGTH) ||
+                 memcmp(alpn, ALPN_HTTP_1_1, ALPN_HTTP_1_1_LENGTH)))
+    return;
+
+  if(conn->bits.tls_enable_alpn &&
+     SSL_set_alpn_protos(BACKEND->handle, http11, sizeof(http11)))
+    return;
+
+  BACKEND->early_max = SSL_SESSION_get_max_early_data(session);
+  BACKEND->early_pending = TRUE;
+  infof(data, "TLS early data allowed, up to %zu bytes\n",
+        BACKEND->early_max);
+}
+#endif
+
+#ifdef HAVE_X509_STORE_UP_REF
+/*
+ * Loading and parsing a full CA bundle is expensive and was done again for
+ * every new connection. The parsed certificate store is therefore kept in the
+ * multi handle and re-used by all connections it makes that verify the peer
+ * against the same CA file and path. The file's modification time and size
+ * are remembered so that an updated bundle gets loaded again.
+ *
+ * Peer certificate chains that have been verified against the cached store
+ * are remembered as well, by their SHA-256 digest, so that the same chain
+ * presented again is not verified again until a certificate in it expires.
+ * A connection that re-uses a chain this way does not build the verified
+ * chain either: X509_STORE_CTX_get0_chain() and SSL_get0_verified_chain()
+ * return nothing for it. libcurl itself only uses the chain the peer sent,
+ * from SSL_get_peer_cert_chain().
+ */
+#define OSSL_CHAIN_DIGEST_LEN 32 /* SHA-256 */
+#define OSSL_CHAIN_CACHE_SIZE 16 /* verified chains to remember */
+
+struct ossl_verified_chain {
+  unsigned char digest[OSSL_CHAIN_DIGEST_LEN];
+  time_t expires;               /* when the first certificate expires, 0 if
+                                   the entry is not in use */
+};
+
+struct multi_ssl_backend_data {
+  char *CAfile;           /* the CA file the store was loaded from */
+  char *CApath;           /* the CA path the store was set up with */
+  time_t CAfile_mtime;    /* modification time of CAfile when loaded */
+  curl_off_t CAfile_size; /* size of CAfile when loaded */
+  bool no_partialchain;   /* the store was set up without partial chains */
+  X509_STORE *store;
+  /* chains verified against this store */
+  struct ossl_verified_chain chains[OSSL_CHAIN_CACHE_SIZE];
+};
+
+static void ossl_free_multi_ssl_backend_data(
+  struct multi_ssl_backend_data *mb)
+{
+  X509_STORE_free(mb->store);
+  free(mb->CAfile);
+  free(mb->CApath);
+  free(mb);
+}
+
+/* the strings are equal or both NULL */
+static bool ossl_strequal(const char *s1, const char *s2)
+{
+  if(s1 && s2)
+    return !strcmp(s1, s2);
+  return !s1 && !s2;
+}
+
+/*
+ * Get the modification time and size of the CA file. Returns FALSE if there
+ * is a CA file that cannot be checked, and thus no store to cache for it.
+ */
+static bool ossl_cafile_stat(const char *cafile, time_t *mtime,
+                             curl_off_t *size)
+{
+  struct_stat st;
+
+  *mtime = 0;
+  *size = 0;
+  if(cafile) {
+    if(stat(cafile, &st))
+      return FALSE;
+    *mtime = st.st_mtime;
+    *size = (curl_off_t)st.st_size;
+  }
+  return TRUE;
+}
+
+/*
+ * Make the SSL_CTX use the store cached in the multi handle, if there is one
+ * set up from the same CA file and path. Returns TRUE if it does.
+ */
+static bool ossl_get_cached_store(struct Curl_multi *multi, SSL_CTX *ctx,
+                                  const char *cafile, const char *capath,
+                                  bool no_partialchain, time_t mtime,
+                                  curl_off_t size)
+{
+  struct multi_ssl_backend_data *mb = multi->ssl_backend_data;
+
+  if(!mb || !mb->store ||
+     (mb->no_partialchain != no_partialchain) ||
+     (mb->CAfile_mtime != mtime) || (mb->CAfile_size != size) ||
+     !ossl_strequal(mb->CAfile, cafile) ||
+     !ossl_strequal(mb->CApath, capath))
+    return FALSE;
+
+  /* SSL_CTX_set_cert_store() takes over the reference */
+  if(!X509_STORE_up_ref(mb->store))
+    return FALSE;
+  SSL_CTX_set_cert_store(ctx, mb->store);
+  return TRUE;
+}
+
+/*
+ * Keep the store of the SSL_CTX in the multi handle for future connections,
+ * replacing any previously cached one. Failing to do so is not an error.
+ */
+static void ossl_set_cached_store(struct Curl_multi *multi, SSL_CTX *ctx,
+                                  const char *cafile, const char *capath,
+                                  bool no_partialchain, time_t mtime,
+                                  curl_off_t size)
+{
+  struct multi_ssl_backend_data *mb = multi->ssl_backend_data;
+  X509_STORE *store = SSL_CTX_get_cert_store(ctx);
+  char *CAfile = NULL;
+  char *CApath = NULL;
+
+  if(!mb) {
+    mb = calloc(1, sizeof(struct multi_ssl_backend_data));
+    if(!mb)
+      return;
+    multi->ssl_backend_data = mb;
+  }
+
+  if(cafile) {
+    CAfile = strdup(cafile);
+    if(!CAfile)
+      return;
+  }
+  if(capath) {
+    CApath = strdup(capath);
+    if(!CApath) {
+      free(CAfile);
+      return;
+    }
+  }
+  if(!store || !X509_STORE_up_ref(store)) {
+    free(CAfile);
+    free(CApath);
+    return;
+  }
+
+  X509_STORE_free(mb->store);
+  free(mb->CAfile);
+  free(mb->CApath);
+  mb->store = store;
+  mb->CAfile = CAfile;
+  mb->CApath = CApath;
+  mb->CAfile_mtime = mtime;
+  mb->CAfile_size = size;
+  mb->no_partialchain = no_partialchain;
+  memset(mb->chains, 0, sizeof(mb->chains));
+}
+
+/*
+ * Calculate the digest of the leaf certificate and the untrusted chain the
+ * peer sent along with it. Returns FALSE on failure.
+ */
+static bool ossl_chain_digest(X509_STORE_CTX *ctx, unsigned char *digest)
+{
+  STACK_OF(X509) *untrusted = X509_STORE_CTX_get0_untrusted(ctx);
+  X509 *cert = X509_STORE_CTX_get0_cert(ctx);
+  unsigned char md[EVP_MAX_MD_SIZE];
+  unsigned int mdlen;
+  EVP_MD_CTX *mdctx;
+  bool ok;
+  int i;
+
+  if(!cert)
+    return FALSE;
+
+  mdctx = EVP_MD_CTX_create();
+  if(!mdctx)
+    return FALSE;
+  ok = EVP_DigestInit_ex(mdctx, EVP_sha256(), NULL) &&
+    X509_digest(cert, EVP_sha256(), md, &mdlen) &&
+    EVP_DigestUpdate(mdctx, md, mdlen);
+  for(i = 0; ok && untrusted && (i < sk_X509_num(untrusted)); i++)
+    ok = X509_digest(sk_X509_value(untrusted, i), EVP_sha256(), md, &mdlen) &&
+      EVP_DigestUpdate(mdctx, md, mdlen);
+  if(ok)
+    ok = EVP_DigestFinal_ex(mdctx, digest, &mdlen) &&
+      (mdlen == OSSL_CHAIN_DIGEST_LEN);
+  EVP_MD_CTX_destroy(mdctx);
+  return ok;
+}
+
+/*
+ * Remember a successfully verified chain until the first of its certificates
+ * expires, replacing the entry that expires first if the cache is full.
+ */
+static void ossl_chain_remember(struct multi_ssl_backend_data *mb,
+                                X509_STORE_CTX *ctx,
+                                const unsigned char *digest, time_t now)
+{
+  STACK_OF(X509) *chain = X509_STORE_CTX_get0_chain(ctx);
+  struct ossl_verified_chain *entry = &mb->chains[0];
+  time_t expires = 0;
+  int i;
+
+  for(i = 0; chain && (i < sk_X509_num(chain)); i++) {
+    int days, secs;
+    time_t notafter;
+    if(!ASN1_TIME_diff(&days, &secs, NULL,
+                       X509_get0_notAfter(sk_X509_value(chain, i))) ||
+       (days < 0) || (secs < 0))
+      return;
+    notafter = now + (time_t)days * 86400 + secs;
+    if(!expires || (notafter < expires))
+      expires = notafter;
+  }
+  if(!expires)
+    return;
+
+  for(i = 1; i < OSSL_CHAIN_CACHE_SIZE; i++) {
+    if(mb->chains[i].expires < entry->expires)
+      entry = &mb->chains[i];
+  }
+  memcpy(entry->digest, digest, OSSL_CHAIN_DIGEST_LEN);
+  entry->expires = expires;
+}
+
+/*
+ * Certificate verify callback for connections that use the store cached in
+ * the multi handle. A chain that has already been verified against the same
+ * store is accepted without doing the verification again.
+ */
+static int ossl_verify_cached_chain(X509_STORE_CTX *ctx, void *arg)
+{
+  struct connectdata *conn = (struct connectdata *)arg;
+  struct Curl_easy *data = conn->data;
+  struct multi_ssl_backend_data *mb =
+    data->multi ? data->multi->ssl_backend_data : NULL;
+  unsigned char digest[OSSL_CHAIN_DIGEST_LEN];
+  time_t now = time(NULL);
+  int rc;
+  int i;
+
+  if(!mb || !mb->store || (X509_STORE_CTX_get0_store(ctx) != mb->store) ||
+     !ossl_chain_digest(ctx, digest))
+    return X509_verify_cert(ctx);
+
+  for(i = 0; i < OSSL_CHAIN_CACHE_SIZE; i++) {
+    if((mb->chains[i].expires > now) &&
+       !memcmp(mb->chains[i].digest, digest, OSSL_CHAIN_DIGEST_LEN)) {
+      infof(data, "re-using already verified certificate chain\n");
+      X509_STORE_CTX_set_error(ctx, X509_V_OK);
+      return 1;
+    }
+  }
+
+  rc = X509_verify_cert(ctx);
+  if((rc > 0) && (X509_STORE_CTX_get_error(ctx) == X509_V_OK))
+    ossl_chain_remember(mb, ctx, digest, now);
+  return rc;
+}
+#endif /* HAVE_X509_STORE_UP_REF */
+
 static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
 {
   CURLcode result = CURLE_OK;
@@ -2420,6 +2819,12 @@ static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
   const bool verifypeer = SSL_CONN_CONFIG(verifypeer);
   const char * const ssl_crlfile = SSL_SET_OPTION(CRLfile);
   char error_buffer[256];
+  bool store_cached = FALSE;
+#ifdef HAVE_X509_STORE_UP_REF
+  bool cache_store;
+  time_t cafile_mtime = 0;
+  curl_off_t cafile_size = 0;
+#endif
 
   DEBUGASSERT(ssl_connect_1 == connssl->connecting_state);
 
@@ -2623,6 +3028,12 @@ static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
 
   SSL_CTX_set_options(BACKEND->ctx, ctx_options);
 
+#ifdef HAVE_SSL_HAS_PENDING
+  /* make room for several records, for read-ahead once connected */
+  if(!SSL_SET_OPTION(ktls))
+    SSL_CTX_set_default_read_buffer_len(BACKEND->ctx, OSSL_READ_BUFFER_LEN);
+#endif
+
 #ifdef HAS_NPN
   if(conn->bits.tls_enable_npn)
     SSL_CTX_set_next_proto_select_cb(BACKEND->ctx, select_next_proto_cb, conn);
@@ -2720,7 +3131,28 @@ static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
   }
 #endif
 
-  if(ssl_cafile || ssl_capath) {
+#ifdef HAVE_X509_STORE_UP_REF
+  /* A store that a CRL file or the application's ssl ctx callback may add to
+     is not shared with other connections. */
+  cache_store = verifypeer && data->multi && (ssl_cafile || ssl_capath) &&
+    !ssl_crlfile && !data->set.ssl.fsslctx &&
+    ossl_cafile_stat(ssl_cafile, &cafile_mtime, &cafile_size);
+  if(cache_store)
+    store_cached = ossl_get_cached_store(data->multi, BACKEND->ctx,
+                                         ssl_cafile, ssl_capath,
+                                         SSL_SET_OPTION(no_partialchain),
+                                         cafile_mtime, cafile_size);
+#endif
+
+  if(store_cached) {
+    infof(data,
+          "re-using already parsed certificate verify locations:\n"
+          "  CAfile: %s\n"
+          "  CApath: %s\n",
+          ssl_cafile ? ssl_cafile : "none",
+          ssl_capath ? ssl_capath : "none");
+  }
+  else if(ssl_cafile || ssl_capath) {
     /* tell SSL where to find CA certificates that are used to verify
        the servers certificate. */
     if(!SSL_CTX_load_verify_locations(BACKEND->ctx, ssl_cafile, ssl_capath)) {
@@ -2797,6 +3229,17 @@ static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
 #endif
   }
 
+#ifdef HAVE_X509_STORE_UP_REF
+  if(cache_store) {
+    if(!store_cached)
+      ossl_set_cached_store(data->multi, BACKEND->ctx, ssl_cafile, ssl_capath,
+                            SSL_SET_OPTION(no_partialchain),
+                            cafile_mtime, cafile_size);
+    SSL_CTX_set_cert_verify_callback(BACKEND->ctx, ossl_verify_cached_chain,
+                                     conn);
+  }
+#endif
+
   /* SSL always tries to verify the peer, this only says whether it should
    * fail to connect if the verification fails, or if it should continue
    * anyway. In the latter case the result of the verification is checked with
@@ -2889,6 +3332,9 @@ static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
       }
       /* Informational message */
       infof(data, "SSL re-using session ID\n");
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+      ossl_early_data_setup(conn, sockindex, ssl_sessionid);
+#endif
     }
     Curl_ssl_sessionid_unlock(conn);
   }
@@ -2908,6 +3354,12 @@ static CURLcode ossl_connect_step1(struct connectdata *conn, int sockindex)
           ossl_strerror(ERR_get_error(), error_buffer, sizeof(error_buffer)));
     return CURLE_SSL_CONNECT_ERROR;
   }
+#ifdef HAVE_KTLS
+  else if(SSL_SET_OPTION(ktls))
+    /* let the kernel do the record encryption on the raw socket, if it can
+       for the negotiated cipher */
+    SSL_set_options(BACKEND->handle, SSL_OP_ENABLE_KTLS);
+#endif
 
   connssl->connecting_state = ssl_connect_2;
 
@@ -3029,6 +3481,8 @@ static CURLcode ossl_connect_step2(struct connectdata *conn, int sockindex)
     infof(data, "SSL connection using %s / %s\n",
           get_ssl_version_txt(BACKEND->handle),
           SSL_get_cipher(BACKEND->handle));
+    if(SSL_session_reused(BACKEND->handle))
+      infof(data, "SSL session resumed\n");
 
 #ifdef HAS_ALPN
     /* Sets data and len to negotiated protocol, len is 0 if no protocol was
@@ -3645,6 +4099,7 @@ static CURLcode servercert(struct connectdata *conn,
 static CURLcode ossl_connect_step3(struct connectdata *conn, int sockindex)
 {
   CURLcode result = CURLE_OK;
+  struct Curl_easy *data = conn->data;
   struct ssl_connect_data *connssl = &conn->ssl[sockindex];
 
   DEBUGASSERT(ssl_connect_3 == connssl->connecting_state);
@@ -3659,6 +4114,31 @@ static CURLcode ossl_connect_step3(struct connectdata *conn, int sockindex)
   result = servercert(conn, connssl, (SSL_CONN_CONFIG(verifypeer) ||
                                       SSL_CONN_CONFIG(verifyhost)));
 
+#ifdef HAVE_KTLS
+  if(!result && SSL_SET_OPTION(ktls) && !SSL_IS_PROXY() &&
+     !conn->proxy_ssl[sockindex].use) {
+    int ktls_send = (int)BIO_get_ktls_send(SSL_get_wbio(BACKEND->handle));
+    int ktls_recv = (int)BIO_get_ktls_recv(SSL_get_rbio(BACKEND->handle));
+    infof(data, "kTLS %s for sending, %s for receiving\n",
+          ktls_send ? "used" : "not used", ktls_recv ? "used" : "not used");
+  }
+#endif
+
+#ifdef HAVE_SSL_HAS_PENDING
+  /* Read as much as the socket has to give into the buffer, instead of
+     reading each record header and body separately. Data left in it is
+     reported by Curl_ossl_data_pending(). Not for an HTTPS proxy, where a
+     read for one transfer may leave data for others in the buffer while they
+     wait for the socket, nor with kTLS where the kernel reads. HTTP/2 reads
+     until nothing is left, see h2_fill_inbuf(). Not for the protocols that
+     wait for server responses with Curl_pp_statemach() either, as a part of
+     a record in the buffer counts as pending there and they would spin
+     until the rest arrives. */
+  if(!result && !SSL_SET_OPTION(ktls) && !SSL_IS_PROXY() &&
+     !(conn->handler->protocol & OSSL_PINGPONG_PROTOCOLS))
+    SSL_set_read_ahead(BACKEND->handle, 1);
+#endif
+
   if(!result)
     connssl->connecting_state = ssl_connect_done;
 
@@ -3699,6 +4179,16 @@ static CURLcode ossl_connect_common(struct connectdata *conn,
     result = ossl_connect_step1(conn, sockindex);
     if(result)
       return result;
+
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+    if(BACKEND->early_pending) {
+      /* the handshake completes when the request has been sent as early
+         data, so consider it connected already */
+      if(conn->bits.tls_enable_alpn)
+        Curl_multiuse_state(conn, BUNDLE_NO_MULTIUSE);
+      connssl->connecting_state = ssl_connect_done;
+    }
+#endif
   }
 
   while(ssl_connect_2 == connssl->connecting_state ||
@@ -3805,10 +4295,10 @@ static bool Curl_ossl_data_pending(const struct connectdata *conn,
   const struct ssl_connect_data *connssl = &conn->ssl[connindex];
   const struct ssl_connect_data *proxyssl = &conn->proxy_ssl[connindex];
 
-  if(connssl->backend->handle && SSL_pending(connssl->backend->handle))
+  if(connssl->backend->handle && ossl_pending(connssl->backend->handle))
     return TRUE;
 
-  if(proxyssl->backend->handle && SSL_pending(proxyssl->backend->handle))
+  if(proxyssl->backend->handle && ossl_pending(proxyssl->backend->handle))
     return TRUE;
 
   return FALSE;
@@ -3816,6 +4306,158 @@ static bool Curl_ossl_data_pending(const struct connectdata *conn,
 
 static size_t Curl_ossl_version(char *buffer, size_t size);
 
+#ifdef HAVE_X509_CHECK_HOST
+/*
+ * Check if the certificate the server presented on this connection is valid
+ * for the given host name too.
+ */
+static bool Curl_ossl_peer_cert_matches(struct connectdata *conn,
+                                        int sockindex, const char *hostname)
+{
+  const struct ssl_connect_data *connssl = &conn->ssl[sockindex];
+  X509 *cert;
+  bool matches;
+
+  if(!BACKEND->handle)
+    return FALSE;
+
+  cert = SSL_get_peer_certificate(BACKEND->handle);
+  if(!cert)
+    return FALSE;
+
+  matches = (X509_check_host(cert, hostname, 0,
+                             X509_CHECK_FLAG_NO_PARTIAL_WILDCARDS,
+                             NULL) == 1);
+  X509_free(cert);
+  return matches;
+}
+#endif
+
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+/*
+ * Send what is left of the early data again, as the server rejected it.
+ * Returns CURLE_AGAIN until all of it is sent.
+ */
+static CURLcode ossl_early_replay(struct connectdata *conn, int sockindex)
+{
+  struct ssl_connect_data *connssl = &conn->ssl[sockindex];
+  char error_buffer[256];
+
+  while(BACKEND->early_sent < BACKEND->early_len) {
+    size_t len = BACKEND->early_len - BACKEND->early_sent;
+    int rc;
+
+    ERR_clear_error();
+    rc = SSL_write(BACKEND->handle, BACKEND->early_data + BACKEND->early_sent,
+                   (len > (size_t)INT_MAX) ? INT_MAX : (int)len);
+    if(rc <= 0) {
+      int err = SSL_get_error(BACKEND->handle, rc);
+      if((err == SSL_ERROR_WANT_READ) || (err == SSL_ERROR_WANT_WRITE))
+        return CURLE_AGAIN;
+      failf(conn->data, "SSL_write() error: %s",
+            ossl_strerror(ERR_get_error(), error_buffer,
+                          sizeof(error_buffer)));
+      return CURLE_SEND_ERROR;
+    }
+    BACKEND->early_sent += rc;
+  }
+
+  Curl_safefree(BACKEND->early_data);
+  BACKEND->early_len = 0;
+  return CURLE_OK;
+}
+
+/*
+ * Complete the handshake of a connection that sent early data and check the
+ * server certificate the same way as a normal connect does. Returns
+ * CURLE_AGAIN while this is not done, including sending the early data again
+ * if the server rejected it.
+ */
+static CURLcode ossl_early_finish(struct connectdata *conn, int sockindex)
+{
+  struct Curl_easy *data = conn->data;
+  struct ssl_connect_data *connssl = &conn->ssl[sockindex];
+  CURLcode result;
+
+  if(BACKEND->early_pending) {
+    if((ssl_connect_2 != connssl->connecting_state) &&
+       (ssl_connect_2_reading != connssl->connecting_state) &&
+       (ssl_connect_2_writing != connssl->connecting_state))
+      connssl->connecting_state = ssl_connect_2;
+
+    result = ossl_connect_step2(conn, sockindex);
+    if(!result && (ssl_connect_3 == connssl->connecting_state))
+      result = ossl_connect_step3(conn, sockindex);
+    if(result)
+      return result;
+    if(ssl_connect_done != connssl->connecting_state)
+      return CURLE_AGAIN;
+
+    connssl->connecting_state = ssl_connect_1;
+    BACKEND->early_pending = FALSE;
+
+    if(SSL_get_early_data_status(BACKEND->handle) == SSL_EARLY_DATA_ACCEPTED) {
+      infof(data, "TLS early data accepted\n");
+      Curl_safefree(BACKEND->early_data);
+      BACKEND->early_len = 0;
+    }
+    else if(BACKEND->early_len)
+      infof(data, "TLS early data rejected, sending it again\n");
+  }
+
+  if(BACKEND->early_data)
+    return ossl_early_replay(conn, sockindex);
+  return CURLE_OK;
+}
+
+/*
+ * Send data on a connection that is still doing its handshake, as early data
+ * as long as the session allows that much. Otherwise the handshake needs to
+ * complete first.
+ */
+static ssize_t ossl_send_early(struct connectdata *conn,
+                               int sockindex,
+                               const void *mem,
+                               size_t len,
+                               CURLcode *curlcode)
+{
+  struct ssl_connect_data *connssl = &conn->ssl[sockindex];
+  char error_buffer[256];
+  size_t written;
+  char *copy;
+
+  if(BACKEND->early_pending &&
+     (len <= BACKEND->early_max - BACKEND->early_len)) {
+    ERR_clear_error();
+    if(!SSL_write_early_data(BACKEND->handle, mem, len, &written)) {
+      int err = SSL_get_error(BACKEND->handle, 0);
+      if((err == SSL_ERROR_WANT_READ) || (err == SSL_ERROR_WANT_WRITE)) {
+        *curlcode = CURLE_AGAIN;
+        return -1;
+      }
+      failf(conn->data, "SSL_write_early_data() error: %s",
+            ossl_strerror(ERR_get_error(), error_buffer,
+                          sizeof(error_buffer)));
+      *curlcode = CURLE_SEND_ERROR;
+      return -1;
+    }
+    copy = realloc(BACKEND->early_data, BACKEND->early_len + written);
+    if(!copy) {
+      *curlcode = CURLE_OUT_OF_MEMORY;
+      return -1;
+    }
+    memcpy(copy + BACKEND->early_len, mem, written);
+    BACKEND->early_data = copy;
+    BACKEND->early_len += written;
+    *curlcode = CURLE_OK;
+    return (ssize_t)written;
+  }
+
+  *curlcode = ossl_early_finish(conn, sockindex);
+  return *curlcode ? -1 : 0;
+}
+#endif
+
 static ssize_t ossl_send(struct connectdata *conn,
                          int sockindex,
                          const void *mem,
@@ -3831,6 +4473,14 @@ static ssize_t ossl_send(struct connectdata *conn,
   int rc;
   struct ssl_connect_data *connssl = &conn->ssl[sockindex];
 
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+  if(BACKEND->early_pending || BACKEND->early_data) {
+    ssize_t nwritten = ossl_send_early(conn, sockindex, mem, len, curlcode);
+    if(nwritten || *curlcode)
+      return nwritten;
+  }
+#endif
+
   ERR_clear_error();
 
   memlen = (len > (size_t)INT_MAX) ? INT_MAX : (int)len;
@@ -3905,6 +4555,14 @@ static ssize_t ossl_recv(struct connectdata *conn, /* connection data */
   int buffsize;
   struct ssl_connect_data *connssl = &conn->ssl[num];
 
+#ifdef HAVE_SSL_WRITE_EARLY_DATA
+  if(BACKEND->early_pending || BACKEND->early_data) {
+    *curlcode = ossl_early_finish(conn, num);
+    if(*curlcode)
+      return -1;
+  }
+#endif
+
   ERR_clear_error();
 
   buffsize = (buffersize > (size_t)INT_MAX) ? INT_MAX : (int)buffersize;
@@ -4149,15 +4807,27 @@ const struct Curl_ssl Curl_ssl_openssl = {
   Curl_ossl_close,               /* close_one */
   Curl_ossl_close_all,           /* close_all */
   Curl_ossl_session_free,        /* session_free */
+  Curl_ossl_session_export,      /* session_export */
+  Curl_ossl_session_import,      /* session_import */
   Curl_ossl_set_engine,          /* set_engine */
   Curl_ossl_set_engine_default,  /* set_engine_default */
   Curl_ossl_engines_list,        /* engines_list */
   Curl_none_false_start,         /* false_start */
   Curl_ossl_md5sum,              /* md5sum */
 #if (OPENSSL_VERSION_NUMBER >= 0x0090800fL) && !defined(OPENSSL_NO_SHA256)
-  Curl_ossl_sha256sum            /* sha256sum */
+  Curl_ossl_sha256sum,           /* sha256sum */
+#else
+  NULL,                          /* sha256sum */
+#endif
+#ifdef HAVE_X509_STORE_UP_REF
+  ossl_free_multi_ssl_backend_data, /* free_multi_ssl_backend_data */
+#else
+  NULL,                          /* free_multi_ssl_backend_data */
+#endif
+#ifdef HAVE_X509_CHECK_HOST
+  Curl_ossl_peer_cert_matches    /* peer_cert_matches */
 #else
-  NULL                           /* sha256sum */
+  NULL                           /* peer_cert_matches */
 #endif
 };
 
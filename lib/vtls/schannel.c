@@ -2293,12 +2293,16 @@ const struct Curl_ssl Curl_ssl_schannel = {
   Curl_schannel_close,               /* close_one */
   Curl_none_close_all,               /* close_all */
   Curl_schannel_session_free,        /* session_free */
+  NULL,                              /* session_export */
+  NULL,                              /* session_import */
   Curl_none_set_engine,              /* set_engine */
   Curl_none_set_engine_default,      /* set_engine_default */
   Curl_none_engines_list,            /* engines_list */
   Curl_none_false_start,             /* false_start */
   Curl_schannel_md5sum,              /* md5sum */
-  Curl_schannel_sha256sum            /* sha256sum */
+  Curl_schannel_sha256sum,           /* sha256sum */
+  NULL,                              /* free_multi_ssl_backend_data */
+  NULL                               /* peer_cert_matches */
 };
 
 #endif /* USE_SCHANNEL */
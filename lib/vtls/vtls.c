@@ -47,6 +47,9 @@
 #ifdef HAVE_FCNTL_H
 #include <fcntl.h>
 #endif
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
 
 #include "urldata.h"
 
@@ -58,10 +61,12 @@
 #include "progress.h"
 #include "share.h"
 #include "multiif.h"
+#include "rand.h"
 #include "timeval.h"
 #include "curl_md5.h"
 #include "warnless.h"
 #include "curl_base64.h"
+#include "curl_get_line.h"
 #include "curl_printf.h"
 
 /* The last #include files should be: */
@@ -300,6 +305,43 @@ void Curl_ssl_sessionid_unlock(struct connectdata *conn)
     Curl_share_unlock(conn->data, CURL_LOCK_DATA_SSL_SESSION);
 }
 
+/*
+ * A cheap case insensitive hash of a host name and port number, stored with
+ * each cached session to quickly skip the entries that cannot match.
+ */
+static unsigned int session_hash(const char *name, int port)
+{
+  unsigned int hash = 5381;
+  while(*name)
+    hash = (hash << 5) + hash + (unsigned char)Curl_raw_toupper(*name++);
+  return hash ^ (unsigned int)port;
+}
+
+/*
+ * Check if the given cached session was used for the same host, port, scheme
+ * and SSL configuration.
+ */
+static bool session_match(struct curl_ssl_session *check,
+                          unsigned int hash,
+                          const char *name,
+                          const char *conn_to_host,
+                          int conn_to_port,
+                          int port,
+                          const char *scheme,
+                          struct ssl_primary_config *ssl_config)
+{
+  return check->sessionid &&
+    (check->hash == hash) &&
+    (port == check->remote_port) &&
+    (conn_to_port == check->conn_to_port) &&
+    strcasecompare(name, check->name) &&
+    ((!conn_to_host && !check->conn_to_host) ||
+     (conn_to_host && check->conn_to_host &&
+      strcasecompare(conn_to_host, check->conn_to_host))) &&
+    strcasecompare(scheme, check->scheme) &&
+    Curl_ssl_config_matches(ssl_config, &check->ssl_config);
+}
+
 /*
  * Check if there's a session ID for the given connection in the cache, and if
  * there's one suitable, it is provided. Returns TRUE when no entry matched.
@@ -322,6 +364,10 @@ bool Curl_ssl_getsessionid(struct connectdata *conn,
   const char * const name = isProxy ? conn->http_proxy.host.name :
     conn->host.name;
   int port = isProxy ? (int)conn->port : conn->remote_port;
+  const char * const conn_to_host = conn->bits.conn_to_host ?
+    conn->conn_to_host.name : NULL;
+  int conn_to_port = conn->bits.conn_to_port ? conn->conn_to_port : -1;
+  unsigned int hash;
   *ssl_sessionid = NULL;
 
   DEBUGASSERT(SSL_SET_OPTION(primary.sessionid));
@@ -336,21 +382,11 @@ bool Curl_ssl_getsessionid(struct connectdata *conn,
   else
     general_age = &data->state.sessionage;
 
+  hash = session_hash(name, port);
   for(i = 0; i < data->set.general_ssl.max_ssl_sessions; i++) {
     check = &data->state.session[i];
-    if(!check->sessionid)
-      /* not session ID means blank entry */
-      continue;
-    if(strcasecompare(name, check->name) &&
-       ((!conn->bits.conn_to_host && !check->conn_to_host) ||
-        (conn->bits.conn_to_host && check->conn_to_host &&
-         strcasecompare(conn->conn_to_host.name, check->conn_to_host))) &&
-       ((!conn->bits.conn_to_port && check->conn_to_port == -1) ||
-        (conn->bits.conn_to_port && check->conn_to_port != -1 &&
-         conn->conn_to_port == check->conn_to_port)) &&
-       (port == check->remote_port) &&
-       strcasecompare(conn->handler->scheme, check->scheme) &&
-       Curl_ssl_config_matches(ssl_config, &check->ssl_config)) {
+    if(session_match(check, hash, name, conn_to_host, conn_to_port, port,
+                     conn->handler->scheme, ssl_config)) {
       /* yes, we have a session ID! */
       (*general_age)++;          /* increase general age */
       check->age = *general_age; /* set this as used in this age */
@@ -386,6 +422,16 @@ void Curl_ssl_kill_session(struct curl_ssl_session *session)
   }
 }
 
+/*
+ * The number of changes made to the session cache in use, shared or not.
+ * CURLOPT_SSL_SESSION_FILE is only written when this moved.
+ */
+static long *session_changes(struct Curl_easy *data)
+{
+  return SSLSESSION_SHARED(data) ? &data->share->sessionchanges :
+    &data->state.sessionchanges;
+}
+
 /*
  * Delete the given session ID from the cache.
  */
@@ -399,43 +445,39 @@ void Curl_ssl_delsessionid(struct connectdata *conn, void *ssl_sessionid)
 
     if(check->sessionid == ssl_sessionid) {
       Curl_ssl_kill_session(check);
+      (*session_changes(data))++;
       break;
     }
   }
 }
 
 /*
- * Store session id in the session cache. The ID passed on to this function
- * must already have been extracted and allocated the proper way for the SSL
- * layer. Curl_XXXX_session_free() will be called to free/kill the session ID
- * later on.
+ * Store a session in the cache, in an empty slot or replacing the oldest
+ * entry if the cache is full. The SSL configuration is cloned.
  */
-CURLcode Curl_ssl_addsessionid(struct connectdata *conn,
-                               void *ssl_sessionid,
-                               size_t idsize,
-                               int sockindex)
+static CURLcode session_store(struct Curl_easy *data,
+                              void *ssl_sessionid,
+                              size_t idsize,
+                              const char *name,
+                              const char *conn_to_host,
+                              int conn_to_port,
+                              int remote_port,
+                              const char *scheme,
+                              struct ssl_primary_config *ssl_config)
 {
   size_t i;
-  struct Curl_easy *data = conn->data; /* the mother of all structs */
   struct curl_ssl_session *store = &data->state.session[0];
   long oldest_age = data->state.session[0].age; /* zero if unused */
   char *clone_host;
   char *clone_conn_to_host;
-  int conn_to_port;
   long *general_age;
-  const bool isProxy = CONNECT_PROXY_SSL();
-  struct ssl_primary_config * const ssl_config = isProxy ?
-    &conn->proxy_ssl_config :
-    &conn->ssl_config;
-
-  DEBUGASSERT(SSL_SET_OPTION(primary.sessionid));
 
-  clone_host = strdup(isProxy ? conn->http_proxy.host.name : conn->host.name);
+  clone_host = strdup(name);
   if(!clone_host)
     return CURLE_OUT_OF_MEMORY; /* bail out */
 
-  if(conn->bits.conn_to_host) {
-    clone_conn_to_host = strdup(conn->conn_to_host.name);
+  if(conn_to_host) {
+    clone_conn_to_host = strdup(conn_to_host);
     if(!clone_conn_to_host) {
       free(clone_host);
       return CURLE_OUT_OF_MEMORY; /* bail out */
@@ -444,11 +486,6 @@ CURLcode Curl_ssl_addsessionid(struct connectdata *conn,
   else
     clone_conn_to_host = NULL;
 
-  if(conn->bits.conn_to_port)
-    conn_to_port = conn->conn_to_port;
-  else
-    conn_to_port = -1;
-
   /* Now we should add the session ID and the host name to the cache, (remove
      the oldest if necessary) */
 
@@ -484,20 +521,370 @@ CURLcode Curl_ssl_addsessionid(struct connectdata *conn,
   store->name = clone_host;               /* clone host name */
   store->conn_to_host = clone_conn_to_host; /* clone connect to host name */
   store->conn_to_port = conn_to_port; /* connect to port number */
-  /* port number */
-  store->remote_port = isProxy ? (int)conn->port : conn->remote_port;
-  store->scheme = conn->handler->scheme;
+  store->remote_port = remote_port; /* port number */
+  store->scheme = scheme;
+  store->hash = session_hash(name, remote_port);
 
   if(!Curl_clone_primary_ssl_config(ssl_config, &store->ssl_config)) {
     store->sessionid = NULL; /* let caller free sessionid */
-    free(clone_host);
-    free(clone_conn_to_host);
+    Curl_safefree(store->name);
+    Curl_safefree(store->conn_to_host);
     return CURLE_OUT_OF_MEMORY;
   }
+  (*session_changes(data))++;
+
+  return CURLE_OK;
+}
+
+/*
+ * Store session id in the session cache. The ID passed on to this function
+ * must already have been extracted and allocated the proper way for the SSL
+ * layer. Curl_XXXX_session_free() will be called to free/kill the session ID
+ * later on.
+ */
+CURLcode Curl_ssl_addsessionid(struct connectdata *conn,
+                               void *ssl_sessionid,
+                               size_t idsize,
+                               int sockindex)
+{
+  struct Curl_easy *data = conn->data; /* the mother of all structs */
+  const bool isProxy = CONNECT_PROXY_SSL();
+  struct ssl_primary_config * const ssl_config = isProxy ?
+    &conn->proxy_ssl_config :
+    &conn->ssl_config;
+
+  DEBUGASSERT(SSL_SET_OPTION(primary.sessionid));
+
+  return session_store(data, ssl_sessionid, idsize,
+                       isProxy ? conn->http_proxy.host.name : conn->host.name,
+                       conn->bits.conn_to_host ?
+                       conn->conn_to_host.name : NULL,
+                       conn->bits.conn_to_port ? conn->conn_to_port : -1,
+                       isProxy ? (int)conn->port : conn->remote_port,
+                       conn->handler->scheme, ssl_config);
+}
+
+
+/*
+ * The session file has one line per session with space separated fields:
+ *
+ * backend scheme host port conn-to-host conn-to-port version version-max
+ * verify-bits CApath CAfile clientcert random-file egdsocket cipher-list
+ * cipher-list13 pinned-key session
+ *
+ * The strings of the SSL configuration and the session blob made by the TLS
+ * backend are base64 encoded. A "-" stands for a NULL or empty field.
+ */
+#define SESSION_FIELDS 18
+#define MAX_SESSION_LINE 16384
+
+/* output one base64 encoded field */
+static CURLcode session_field_out(struct Curl_easy *data, FILE *out,
+                                  const char *str, size_t len)
+{
+  char *b64;
+  size_t b64len;
+  CURLcode result;
 
+  if(!str || !len) {
+    fputs(" -", out);
+    return CURLE_OK;
+  }
+  result = Curl_base64_encode(data, str, len, &b64, &b64len);
+  if(result)
+    return result;
+  fprintf(out, " %s", b64);
+  free(b64);
   return CURLE_OK;
 }
 
+/*
+ * Write a single cached session as a line to the file. Sessions the backend
+ * cannot export are skipped.
+ */
+static CURLcode session_out(struct Curl_easy *data,
+                            struct curl_ssl_session *session, FILE *out)
+{
+  struct ssl_primary_config *config = &session->ssl_config;
+  const char *strs[8];
+  unsigned char *blob;
+  size_t bloblen;
+  size_t i;
+  CURLcode result;
+
+  result = Curl_ssl->session_export(session->sessionid, session->idsize,
+                                    &blob, &bloblen);
+  if(result)
+    return CURLE_OK;
+
+  strs[0] = config->CApath;
+  strs[1] = config->CAfile;
+  strs[2] = config->clientcert;
+  strs[3] = config->random_file;
+  strs[4] = config->egdsocket;
+  strs[5] = config->cipher_list;
+  strs[6] = config->cipher_list13;
+  strs[7] = config->pinned_key;
+
+  fprintf(out, "%s %s %s %d %s %d %ld %ld %d",
+          Curl_ssl->info.name, session->scheme, session->name,
+          session->remote_port,
+          session->conn_to_host ? session->conn_to_host : "-",
+          session->conn_to_port, config->version, config->version_max,
+          (config->verifypeer ? 1 : 0) | (config->verifyhost ? 2 : 0) |
+          (config->verifystatus ? 4 : 0));
+  for(i = 0; !result && (i < sizeof(strs)/sizeof(strs[0])); i++)
+    result = session_field_out(data, out, strs[i],
+                               strs[i] ? strlen(strs[i]) : 0);
+  if(!result)
+    result = session_field_out(data, out, (char *)blob, bloblen);
+  fputs("\n", out);
+  free(blob);
+  return result;
+}
+
+/* decode one string field, a "-" is a NULL string */
+static CURLcode session_field_in(const char *field, char **str)
+{
+  size_t len;
+  *str = NULL;
+  if(!strcmp(field, "-"))
+    return CURLE_OK;
+  return Curl_base64_decode(field, (unsigned char **)str, &len);
+}
+
+/* parse a number field, returns FALSE if it isn't a plain number */
+static bool session_number_in(const char *field, long *value)
+{
+  char *end;
+  *value = strtol(field, &end, 10);
+  return (end != field) && !*end;
+}
+
+/*
+ * Add the session in the given line to the cache, unless it is made by
+ * another TLS backend, for an unknown scheme or already is in the cache.
+ * Returns error only on out of memory.
+ */
+static CURLcode session_load_line(struct Curl_easy *data, char *line)
+{
+  char *field[SESSION_FIELDS];
+  char *strs[8];
+  const struct Curl_handler *handler;
+  struct ssl_primary_config config;
+  long port;
+  long conn_to_port;
+  long bits;
+  unsigned char *blob = NULL;
+  size_t bloblen;
+  void *sessionid = NULL;
+  size_t idsize;
+  size_t i;
+  size_t num = 0;
+  CURLcode result = CURLE_OK;
+
+  while(*line && (num < SESSION_FIELDS)) {
+    while(ISSPACE(*line))
+      line++;
+    if(!*line)
+      break;
+    field[num++] = line;
+    while(*line && !ISSPACE(*line))
+      line++;
+    if(*line)
+      *line++ = 0;
+  }
+  while(ISSPACE(*line))
+    line++;
+  if((num != SESSION_FIELDS) || *line ||
+     strcmp(field[0], Curl_ssl->info.name))
+    return CURLE_OK;
+
+  handler = Curl_builtin_scheme(field[1]);
+  if(!handler || !(handler->flags & PROTOPT_SSL) ||
+     !session_number_in(field[3], &port) ||
+     !session_number_in(field[5], &conn_to_port) ||
+     !session_number_in(field[6], &config.version) ||
+     !session_number_in(field[7], &config.version_max) ||
+     !session_number_in(field[8], &bits))
+    return CURLE_OK;
+
+  memset(strs, 0, sizeof(strs));
+  for(i = 0; i < sizeof(strs)/sizeof(strs[0]); i++) {
+    if(session_field_in(field[9 + i], &strs[i]))
+      goto out;
+  }
+  config.CApath = strs[0];
+  config.CAfile = strs[1];
+  config.clientcert = strs[2];
+  config.random_file = strs[3];
+  config.egdsocket = strs[4];
+  config.cipher_list = strs[5];
+  config.cipher_list13 = strs[6];
+  config.pinned_key = strs[7];
+  config.verifypeer = !!(bits & 1);
+  config.verifyhost = !!(bits & 2);
+  config.verifystatus = !!(bits & 4);
+  config.sessionid = TRUE;
+
+  /* skip it if the cache already has a session for this */
+  for(i = 0; i < data->set.general_ssl.max_ssl_sessions; i++) {
+    if(session_match(&data->state.session[i],
+                     session_hash(field[2], (int)port), field[2],
+                     strcmp(field[4], "-") ? field[4] : NULL,
+                     (int)conn_to_port, (int)port, handler->scheme,
+                     &config))
+      goto out;
+  }
+
+  if(Curl_base64_decode(field[17], &blob, &bloblen) ||
+     Curl_ssl->session_import(blob, bloblen, &sessionid, &idsize))
+    goto out;
+
+  result = session_store(data, sessionid, idsize, field[2],
+                         strcmp(field[4], "-") ? field[4] : NULL,
+                         (int)conn_to_port, (int)port, handler->scheme,
+                         &config);
+  if(result)
+    Curl_ssl->session_free(sessionid);
+
+  out:
+  for(i = 0; i < sizeof(strs)/sizeof(strs[0]); i++)
+    free(strs[i]);
+  free(blob);
+  return result;
+}
+
+/*
+ * Read the sessions saved in the CURLOPT_SSL_SESSION_FILE file into the
+ * session cache, once per handle. The file not existing is not an error.
+ */
+CURLcode Curl_ssl_load_sessions(struct Curl_easy *data)
+{
+  const char *file = data->set.str[STRING_SSL_SESSION_FILE];
+  CURLcode result = CURLE_OK;
+  char *line = NULL;
+  FILE *fp;
+
+  if(!file || !file[0] || data->state.sessionfile_loaded ||
+     !data->state.session || !Curl_ssl->session_import)
+    return CURLE_OK;
+  data->state.sessionfile_loaded = TRUE;
+
+  fp = fopen(file, FOPEN_READTEXT);
+  if(fp) {
+    line = malloc(MAX_SESSION_LINE);
+    if(!line) {
+      fclose(fp);
+      return CURLE_OUT_OF_MEMORY;
+    }
+  }
+
+  if(SSLSESSION_SHARED(data))
+    Curl_share_lock(data, CURL_LOCK_DATA_SSL_SESSION,
+                    CURL_LOCK_ACCESS_SINGLE);
+  while(fp && !result && Curl_get_line(line, MAX_SESSION_LINE, fp)) {
+    char *lineptr = line;
+    while(*lineptr && ISBLANK(*lineptr))
+      lineptr++;
+    if(*lineptr == '#')
+      /* skip commented lines */
+      continue;
+
+    result = session_load_line(data, lineptr);
+  }
+  /* the file gets written once the cache changes from what it is now */
+  data->state.sessionfile_changes = *session_changes(data);
+  if(SSLSESSION_SHARED(data))
+    Curl_share_unlock(data, CURL_LOCK_DATA_SSL_SESSION);
+
+  if(fp) {
+    free(line);
+    fclose(fp);
+  }
+  return result;
+}
+
+/*
+ * Write the sessions in the cache to the CURLOPT_SSL_SESSION_FILE file, if
+ * the cache changed since the file was read or written. The sessions are
+ * written to a temporary file first that then replaces the file, so that a
+ * failed write never leaves a truncated file behind. The sessions hold
+ * secrets, so the file is readable by its owner only.
+ */
+CURLcode Curl_ssl_save_sessions(struct Curl_easy *data)
+{
+  const char *file = data->set.str[STRING_SSL_SESSION_FILE];
+  CURLcode result = CURLE_OK;
+  unsigned char randsuffix[9];
+  char *tempstore = NULL;
+  FILE *out = NULL;
+  size_t i;
+#ifdef HAVE_FCNTL_H
+  int fd;
+#endif
+
+  if(!file || !file[0] || !data->state.session || !Curl_ssl->session_export)
+    return CURLE_OK;
+
+  if(SSLSESSION_SHARED(data))
+    Curl_share_lock(data, CURL_LOCK_DATA_SSL_SESSION,
+                    CURL_LOCK_ACCESS_SINGLE);
+  if(*session_changes(data) == data->state.sessionfile_changes)
+    /* nothing new to write */
+    goto unlock;
+
+  result = Curl_rand_hex(data, randsuffix, sizeof(randsuffix));
+  if(!result) {
+    tempstore = aprintf("%s.%s.tmp", file, randsuffix);
+    if(!tempstore)
+      result = CURLE_OUT_OF_MEMORY;
+  }
+  if(result)
+    goto unlock;
+
+#ifdef HAVE_FCNTL_H
+  fd = open(tempstore, O_WRONLY | O_CREAT | O_EXCL, 0600);
+  out = (fd != -1) ? fdopen(fd, FOPEN_WRITETEXT) : NULL;
+  if(!out && (fd != -1))
+    close(fd);
+#else
+  out = fopen(tempstore, FOPEN_WRITETEXT);
+#endif
+  if(!out) {
+    result = CURLE_WRITE_ERROR;
+    goto unlock;
+  }
+  fputs("# Your TLS session cache. It holds secrets, keep it private!\n"
+        "# This file was generated by libcurl! Edit at your own risk.\n",
+        out);
+
+  for(i = 0; !result && (i < data->set.general_ssl.max_ssl_sessions); i++) {
+    if(data->state.session[i].sessionid)
+      result = session_out(data, &data->state.session[i], out);
+  }
+  if(!result)
+    data->state.sessionfile_changes = *session_changes(data);
+
+unlock:
+  if(SSLSESSION_SHARED(data))
+    Curl_share_unlock(data, CURL_LOCK_DATA_SSL_SESSION);
+
+  if(out) {
+    if(fclose(out) && !result)
+      result = CURLE_WRITE_ERROR;
+    if(!result && rename(tempstore, file)) {
+      /* rename() does not replace an existing file on all systems */
+      (void)unlink(file);
+      if(rename(tempstore, file))
+        result = CURLE_WRITE_ERROR;
+    }
+    if(result)
+      (void)unlink(tempstore);
+  }
+  free(tempstore);
+  return result;
+}
 
 void Curl_ssl_close_all(struct Curl_easy *data)
 {
@@ -515,6 +902,29 @@ void Curl_ssl_close_all(struct Curl_easy *data)
   Curl_ssl->close_all(data);
 }
 
+/*
+ * Free the data the TLS backend keeps in a multi handle, if any.
+ */
+void Curl_ssl_free_multi_ssl_backend_data(struct multi_ssl_backend_data *mb)
+{
+  if(mb && Curl_ssl->free_multi_ssl_backend_data)
+    Curl_ssl->free_multi_ssl_backend_data(mb);
+}
+
+/*
+ * Check if the certificate the server presented on a connection is valid for
+ * another host name too, so that a request to that host name can use the
+ * connection. Returns FALSE if the TLS backend cannot tell.
+ */
+bool Curl_ssl_peer_cert_matches(struct connectdata *conn, int sockindex,
+                                const char *hostname)
+{
+  if(!Curl_ssl->peer_cert_matches ||
+     (conn->ssl[sockindex].state != ssl_connection_complete))
+    return FALSE;
+  return Curl_ssl->peer_cert_matches(conn, sockindex, hostname);
+}
+
 #if defined(USE_OPENSSL) || defined(USE_GNUTLS) || defined(USE_SCHANNEL) || \
   defined(USE_SECTRANSP) || defined(USE_POLARSSL) || defined(USE_NSS) || \
   defined(USE_MBEDTLS) || defined(USE_WOLFSSL) || defined(USE_BEARSSL)
@@ -649,7 +1059,10 @@ void Curl_ssl_free_certinfo(struct Curl_easy *data)
     for(i = 0; i<ci->num_of_certs; i++) {
       curl_slist_free_all(ci->certinfo[i]);
       ci->certinfo[i] = NULL;
+      if(data->info.certder)
+        Curl_safefree(data->info.certder[i].der);
     }
+    Curl_safefree(data->info.certder);
 
     free(ci->certinfo); /* free the actual array too */
     ci->certinfo = NULL;
@@ -1158,12 +1571,16 @@ static const struct Curl_ssl Curl_ssl_multi = {
   Curl_multissl_close,               /* close_one */
   Curl_none_close_all,               /* close_all */
   Curl_none_session_free,            /* session_free */
+  NULL,                              /* session_export */
+  NULL,                              /* session_import */
   Curl_none_set_engine,              /* set_engine */
   Curl_none_set_engine_default,      /* set_engine_default */
   Curl_none_engines_list,            /* engines_list */
   Curl_none_false_start,             /* false_start */
   Curl_none_md5sum,                  /* md5sum */
-  NULL                               /* sha256sum */
+  NULL,                              /* sha256sum */
+  NULL,                              /* free_multi_ssl_backend_data */
+  NULL                               /* peer_cert_matches */
 };
 
 const struct Curl_ssl *Curl_ssl =
@@ -25,6 +25,7 @@
 
 struct connectdata;
 struct ssl_connect_data;
+struct multi_ssl_backend_data;
 
 #define SSLSUPP_CA_PATH      (1<<0) /* supports CAPATH */
 #define SSLSUPP_CERTINFO     (1<<1) /* supports CURLOPT_CERTINFO */
@@ -63,6 +64,12 @@ struct Curl_ssl {
   void (*close_one)(struct connectdata *conn, int sockindex);
   void (*close_all)(struct Curl_easy *data);
   void (*session_free)(void *ptr);
+  /* turn a session into a newly allocated blob to save in a file, and turn
+     such a blob back into a session, both may be NULL if not supported */
+  CURLcode (*session_export)(void *sessionid, size_t idsize,
+                             unsigned char **blob, size_t *bloblen);
+  CURLcode (*session_import)(const unsigned char *blob, size_t bloblen,
+                             void **sessionid, size_t *idsize);
 
   CURLcode (*set_engine)(struct Curl_easy *data, const char *engine);
   CURLcode (*set_engine_default)(struct Curl_easy *data);
@@ -74,6 +81,14 @@ struct Curl_ssl {
                      unsigned char *md5sum, size_t md5sumlen);
   CURLcode (*sha256sum)(const unsigned char *input, size_t inputlen,
                     unsigned char *sha256sum, size_t sha256sumlen);
+
+  /* free backend data kept in a multi handle, may be NULL */
+  void (*free_multi_ssl_backend_data)(struct multi_ssl_backend_data *mb);
+
+  /* check if the server certificate of a connection is valid for another
+     host name as well, may be NULL */
+  bool (*peer_cert_matches)(struct connectdata *conn, int sockindex,
+                            const char *hostname);
 };
 
 #ifdef USE_SSL
@@ -165,8 +180,18 @@ CURLcode Curl_ssl_set_engine(struct Curl_easy *data, const char *engine);
 CURLcode Curl_ssl_set_engine_default(struct Curl_easy *data);
 struct curl_slist *Curl_ssl_engines_list(struct Curl_easy *data);
 
+/* free the TLS backend specific data of a multi handle */
+void Curl_ssl_free_multi_ssl_backend_data(struct multi_ssl_backend_data *mb);
+
+/* check if the server certificate is valid for another host name as well */
+bool Curl_ssl_peer_cert_matches(struct connectdata *conn, int sockindex,
+                                const char *hostname);
+
 /* init the SSL session ID cache */
 CURLcode Curl_ssl_initsessions(struct Curl_easy *, size_t);
+/* read and write the CURLOPT_SSL_SESSION_FILE file */
+CURLcode Curl_ssl_load_sessions(struct Curl_easy *data);
+CURLcode Curl_ssl_save_sessions(struct Curl_easy *data);
 size_t Curl_ssl_version(char *buffer, size_t size);
 bool Curl_ssl_data_pending(const struct connectdata *conn,
                            int connindex);
@@ -255,6 +280,8 @@ bool Curl_ssl_false_start(void);
 #define Curl_ssl_cleanup() Curl_nop_stmt
 #define Curl_ssl_connect(x,y) CURLE_NOT_BUILT_IN
 #define Curl_ssl_close_all(x) Curl_nop_stmt
+#define Curl_ssl_free_multi_ssl_backend_data(x) Curl_nop_stmt
+#define Curl_ssl_peer_cert_matches(x,y,z) FALSE
 #define Curl_ssl_close(x,y) Curl_nop_stmt
 #define Curl_ssl_shutdown(x,y) CURLE_NOT_BUILT_IN
 #define Curl_ssl_set_engine(x,y) CURLE_NOT_BUILT_IN
@@ -263,6 +290,8 @@ bool Curl_ssl_false_start(void);
 #define Curl_ssl_send(a,b,c,d,e) -1
 #define Curl_ssl_recv(a,b,c,d,e) -1
 #define Curl_ssl_initsessions(x,y) CURLE_OK
+#define Curl_ssl_load_sessions(x) CURLE_OK
+#define Curl_ssl_save_sessions(x) CURLE_OK
 #define Curl_ssl_version(x,y) 0
 #define Curl_ssl_data_pending(x,y) 0
 #define Curl_ssl_check_cxn(x) 0
@@ -854,7 +854,11 @@ static const char *dumpAlgo(curl_asn1Element *param,
   return OID2str(oid.beg, oid.end, TRUE);
 }
 
-static void do_pubkey_field(struct Curl_easy *data, int certnum,
+/* Where the certificate information goes. */
+#define CERTINFO_PUSH (1<<0) /* to the list for CURLINFO_CERTINFO */
+#define CERTINFO_SHOW (1<<1) /* to the verbose output */
+
+static void do_pubkey_field(struct Curl_easy *data, int certnum, int out,
                             const char *label, curl_asn1Element *elem)
 {
   const char *output;
@@ -863,15 +867,15 @@ static void do_pubkey_field(struct Curl_easy *data, int certnum,
 
   output = ASN1tostr(elem, 0);
   if(output) {
-    if(data->set.ssl.certinfo)
+    if(out & CERTINFO_PUSH)
       Curl_ssl_push_certinfo(data, certnum, label, output);
-    if(!certnum)
+    if(out & CERTINFO_SHOW)
       infof(data, "   %s: %s\n", label, output);
     free((char *) output);
   }
 }
 
-static void do_pubkey(struct Curl_easy *data, int certnum,
+static void do_pubkey(struct Curl_easy *data, int certnum, int out,
                       const char *algo, curl_asn1Element *param,
                       curl_asn1Element *pubkey)
 {
@@ -904,9 +908,9 @@ static void do_pubkey(struct Curl_easy *data, int certnum,
     }
     if(len > 32)
       elem.beg = q;     /* Strip leading zero bytes. */
-    if(!certnum)
+    if(out & CERTINFO_SHOW)
       infof(data, "   RSA Public Key (%lu bits)\n", len);
-    if(data->set.ssl.certinfo) {
+    if(out & CERTINFO_PUSH) {
       q = curl_maprintf("%lu", len);
       if(q) {
         Curl_ssl_push_certinfo(data, certnum, "RSA Public Key", q);
@@ -914,21 +918,21 @@ static void do_pubkey(struct Curl_easy *data, int certnum,
       }
     }
     /* Generate coefficients. */
-    do_pubkey_field(data, certnum, "rsa(n)", &elem);
+    do_pubkey_field(data, certnum, out, "rsa(n)", &elem);
     if(!getASN1Element(&elem, p, pk.end))
       return;
-    do_pubkey_field(data, certnum, "rsa(e)", &elem);
+    do_pubkey_field(data, certnum, out, "rsa(e)", &elem);
   }
   else if(strcasecompare(algo, "dsa")) {
     p = getASN1Element(&elem, param->beg, param->end);
     if(p) {
-      do_pubkey_field(data, certnum, "dsa(p)", &elem);
+      do_pubkey_field(data, certnum, out, "dsa(p)", &elem);
       p = getASN1Element(&elem, p, param->end);
       if(p) {
-        do_pubkey_field(data, certnum, "dsa(q)", &elem);
+        do_pubkey_field(data, certnum, out, "dsa(q)", &elem);
         if(getASN1Element(&elem, p, param->end)) {
-          do_pubkey_field(data, certnum, "dsa(g)", &elem);
-          do_pubkey_field(data, certnum, "dsa(pub_key)", &pk);
+          do_pubkey_field(data, certnum, out, "dsa(g)", &elem);
+          do_pubkey_field(data, certnum, out, "dsa(pub_key)", &pk);
         }
       }
     }
@@ -936,22 +940,22 @@ static void do_pubkey(struct Curl_easy *data, int certnum,
   else if(strcasecompare(algo, "dhpublicnumber")) {
     p = getASN1Element(&elem, param->beg, param->end);
     if(p) {
-      do_pubkey_field(data, certnum, "dh(p)", &elem);
+      do_pubkey_field(data, certnum, out, "dh(p)", &elem);
       if(getASN1Element(&elem, param->beg, param->end)) {
-        do_pubkey_field(data, certnum, "dh(g)", &elem);
-        do_pubkey_field(data, certnum, "dh(pub_key)", &pk);
+        do_pubkey_field(data, certnum, out, "dh(g)", &elem);
+        do_pubkey_field(data, certnum, out, "dh(pub_key)", &pk);
       }
     }
   }
 }
 
-CURLcode Curl_extract_certinfo(struct connectdata *conn,
-                               int certnum,
-                               const char *beg,
-                               const char *end)
+/*
+ * Output the fields of a parsed certificate to the certinfo list and/or the
+ * verbose output, as told by 'out'.
+ */
+static CURLcode format_certinfo(struct Curl_easy *data, int certnum, int out,
+                                curl_X509certificate *cert)
 {
-  curl_X509certificate cert;
-  struct Curl_easy *data = conn->data;
   curl_asn1Element param;
   const char *ccp;
   char *cp1;
@@ -962,116 +966,106 @@ CURLcode Curl_extract_certinfo(struct connectdata *conn,
   size_t i;
   size_t j;
 
-  if(!data->set.ssl.certinfo)
-    if(certnum)
-      return CURLE_OK;
-
-  /* Prepare the certificate information for curl_easy_getinfo(). */
-
-  /* Extract the certificate ASN.1 elements. */
-  if(Curl_parseX509(&cert, beg, end))
-    return CURLE_PEER_FAILED_VERIFICATION;
-
   /* Subject. */
-  ccp = DNtostr(&cert.subject);
+  ccp = DNtostr(&cert->subject);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Subject", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "%2d Subject: %s\n", certnum, ccp);
   free((char *) ccp);
 
   /* Issuer. */
-  ccp = DNtostr(&cert.issuer);
+  ccp = DNtostr(&cert->issuer);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Issuer", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Issuer: %s\n", ccp);
   free((char *) ccp);
 
   /* Version (always fits in less than 32 bits). */
   version = 0;
-  for(ccp = cert.version.beg; ccp < cert.version.end; ccp++)
+  for(ccp = cert->version.beg; ccp < cert->version.end; ccp++)
     version = (version << 8) | *(const unsigned char *) ccp;
-  if(data->set.ssl.certinfo) {
+  if(out & CERTINFO_PUSH) {
     ccp = curl_maprintf("%lx", version);
     if(!ccp)
       return CURLE_OUT_OF_MEMORY;
     Curl_ssl_push_certinfo(data, certnum, "Version", ccp);
     free((char *) ccp);
   }
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Version: %lu (0x%lx)\n", version + 1, version);
 
   /* Serial number. */
-  ccp = ASN1tostr(&cert.serialNumber, 0);
+  ccp = ASN1tostr(&cert->serialNumber, 0);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Serial Number", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Serial Number: %s\n", ccp);
   free((char *) ccp);
 
   /* Signature algorithm .*/
-  ccp = dumpAlgo(&param, cert.signatureAlgorithm.beg,
-                 cert.signatureAlgorithm.end);
+  ccp = dumpAlgo(&param, cert->signatureAlgorithm.beg,
+                 cert->signatureAlgorithm.end);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Signature Algorithm", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Signature Algorithm: %s\n", ccp);
   free((char *) ccp);
 
   /* Start Date. */
-  ccp = ASN1tostr(&cert.notBefore, 0);
+  ccp = ASN1tostr(&cert->notBefore, 0);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Start Date", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Start Date: %s\n", ccp);
   free((char *) ccp);
 
   /* Expire Date. */
-  ccp = ASN1tostr(&cert.notAfter, 0);
+  ccp = ASN1tostr(&cert->notAfter, 0);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Expire Date", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Expire Date: %s\n", ccp);
   free((char *) ccp);
 
   /* Public Key Algorithm. */
-  ccp = dumpAlgo(&param, cert.subjectPublicKeyAlgorithm.beg,
-                 cert.subjectPublicKeyAlgorithm.end);
+  ccp = dumpAlgo(&param, cert->subjectPublicKeyAlgorithm.beg,
+                 cert->subjectPublicKeyAlgorithm.end);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Public Key Algorithm", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Public Key Algorithm: %s\n", ccp);
-  do_pubkey(data, certnum, ccp, &param, &cert.subjectPublicKey);
+  do_pubkey(data, certnum, out, ccp, &param, &cert->subjectPublicKey);
   free((char *) ccp);
 
   /* Signature. */
-  ccp = ASN1tostr(&cert.signature, 0);
+  ccp = ASN1tostr(&cert->signature, 0);
   if(!ccp)
     return CURLE_OUT_OF_MEMORY;
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Signature", ccp);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "   Signature: %s\n", ccp);
   free((char *) ccp);
 
   /* Generate PEM certificate. */
-  result = Curl_base64_encode(data, cert.certificate.beg,
-                              cert.certificate.end - cert.certificate.beg,
+  result = Curl_base64_encode(data, cert->certificate.beg,
+                              cert->certificate.end - cert->certificate.beg,
                               &cp1, &cl1);
   if(result)
     return result;
@@ -1096,14 +1090,98 @@ CURLcode Curl_extract_certinfo(struct connectdata *conn,
   i += copySubstring(cp2 + i, "-----END CERTIFICATE-----");
   cp2[i] = '\0';
   free(cp1);
-  if(data->set.ssl.certinfo)
+  if(out & CERTINFO_PUSH)
     Curl_ssl_push_certinfo(data, certnum, "Cert", cp2);
-  if(!certnum)
+  if(out & CERTINFO_SHOW)
     infof(data, "%s\n", cp2);
   free(cp2);
   return CURLE_OK;
 }
 
+/*
+ * Keep a copy of a certificate, to format into the certinfo list when that
+ * is asked for.
+ */
+static CURLcode keep_certder(struct Curl_easy *data, int certnum,
+                             const char *beg, const char *end)
+{
+  struct curl_certinfo *ci = &data->info.certs;
+  struct certder *cd;
+
+  if(!data->info.certder) {
+    data->info.certder = calloc((size_t) ci->num_of_certs,
+                                sizeof(struct certder));
+    if(!data->info.certder)
+      return CURLE_OUT_OF_MEMORY;
+  }
+
+  cd = &data->info.certder[certnum];
+  free(cd->der);
+  cd->len = end - beg;
+  cd->der = malloc(cd->len);
+  if(!cd->der)
+    return CURLE_OUT_OF_MEMORY;
+  memcpy(cd->der, beg, cd->len);
+  return CURLE_OK;
+}
+
+CURLcode Curl_extract_certinfo(struct connectdata *conn,
+                               int certnum,
+                               const char *beg,
+                               const char *end)
+{
+  curl_X509certificate cert;
+  struct Curl_easy *data = conn->data;
+  int out = 0;
+
+  if(data->set.ssl.certinfo)
+    out |= CERTINFO_PUSH;
+  if(!certnum && data->set.verbose)
+    out |= CERTINFO_SHOW;
+  if(!out)
+    return CURLE_OK;
+
+  /* Extract the certificate ASN.1 elements. */
+  if(Curl_parseX509(&cert, beg, end))
+    return CURLE_PEER_FAILED_VERIFICATION;
+
+  /* Formatting all the fields is costly and the certificate information is
+     often never asked for, so unless it is to be shown now, only keep the
+     certificate until curl_easy_getinfo() wants the information. */
+  if(out == CERTINFO_PUSH)
+    return keep_certder(data, certnum, beg, end);
+
+  return format_certinfo(data, certnum, out, &cert);
+}
+
+/*
+ * Prepare the certificate information for curl_easy_getinfo() from the
+ * certificates kept by Curl_extract_certinfo().
+ */
+CURLcode Curl_complete_certinfo(struct Curl_easy *data)
+{
+  struct curl_certinfo *ci = &data->info.certs;
+  CURLcode result = CURLE_OK;
+  int i;
+
+  if(!data->info.certder)
+    return CURLE_OK;
+
+  for(i = 0; i < ci->num_of_certs; i++) {
+    struct certder *cd = &data->info.certder[i];
+    if(cd->der && !result) {
+      curl_X509certificate cert;
+      if(Curl_parseX509(&cert, cd->der, cd->der + cd->len))
+        result = CURLE_PEER_FAILED_VERIFICATION;
+      else
+        result = format_certinfo(data, i, CERTINFO_PUSH, &cert);
+    }
+    Curl_safefree(cd->der);
+  }
+  Curl_safefree(data->info.certder);
+  return result;
+}
+
 #endif /* USE_GSKIT or USE_NSS or USE_GNUTLS or USE_WOLFSSL or USE_SCHANNEL */
 
 #if defined(USE_GSKIT)
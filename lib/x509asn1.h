@@ -128,7 +128,10 @@ int Curl_parseX509(curl_X509certificate *cert,
                    const char *beg, const char *end);
 CURLcode Curl_extract_certinfo(struct connectdata *conn, int certnum,
                                const char *beg, const char *end);
+CURLcode Curl_complete_certinfo(struct Curl_easy *data);
 CURLcode Curl_verifyhost(struct connectdata *conn,
                          const char *beg, const char *end);
+#else
+#define Curl_complete_certinfo(x) CURLE_OK
 #endif /* USE_GSKIT or USE_NSS or USE_GNUTLS or USE_WOLFSSL or USE_SCHANNEL */
 #endif /* HEADER_CURL_X509ASN1_H */
@@ -0,0 +1,94 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#include "memdebug.h"
+
+#define MEMSIZE 4000
+
+struct memory {
+  char buf[MEMSIZE + 1];
+  size_t used;
+  int inplace; /* number of write callbacks with data already in 'buf' */
+};
+
+static char *recv_buffer_cb(size_t *size, void *userp)
+{
+  struct memory *mem = (struct memory *)userp;
+  size_t left = MEMSIZE - mem->used;
+
+  if(!left)
+    return NULL;
+  if(left < *size)
+    *size = left;
+  return &mem->buf[mem->used];
+}
+
+static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userp)
+{
+  struct memory *mem = (struct memory *)userp;
+  size_t len = size * nmemb;
+
+  if(len > MEMSIZE - mem->used)
+    return 0;
+
+  if(ptr == &mem->buf[mem->used])
+    mem->inplace++;
+  else
+    memcpy(&mem->buf[mem->used], ptr, len);
+  mem->used += len;
+  return len;
+}
+
+int test(char *URL)
+{
+  CURL *curl = NULL;
+  int res = 0;
+  struct memory mem;
+
+  memset(&mem, 0, sizeof(mem));
+
+  global_init(CURL_GLOBAL_ALL);
+
+  easy_init(curl);
+
+  easy_setopt(curl, CURLOPT_URL, URL);
+  easy_setopt(curl, CURLOPT_BUFFERSIZE, 1024L);
+  easy_setopt(curl, CURLOPT_RECV_BUFFER_FUNCTION, recv_buffer_cb);
+  easy_setopt(curl, CURLOPT_RECV_BUFFER_DATA, &mem);
+  easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+  easy_setopt(curl, CURLOPT_WRITEDATA, &mem);
+
+  res = curl_easy_perform(curl);
+  if(!res) {
+    mem.buf[mem.used] = 0;
+    printf("%sreceived %d bytes, in place: %s\n", mem.buf, (int)mem.used,
+           mem.inplace ? "yes" : "no");
+  }
+
+test_cleanup:
+
+  curl_easy_cleanup(curl);
+  curl_global_cleanup();
+
+  return res;
+}
@@ -0,0 +1,95 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#include "memdebug.h"
+
+/*
+ * Do two transfers with their own easy handles and the same
+ * CURLOPT_SSL_SESSION_FILE: the first one saves its session in the file when
+ * the handle is cleaned up, the second one loads it from there and resumes
+ * it.
+ */
+
+struct resume {
+  int offered; /* a cached session was offered to the server */
+  int resumed; /* the server resumed it */
+};
+
+static int debug_cb(CURL *handle, curl_infotype type, char *text,
+                    size_t size, void *userp)
+{
+  struct resume *r = (struct resume *)userp;
+  (void)handle;
+  if(type == CURLINFO_TEXT) {
+    if((size >= 23) && !memcmp(text, "SSL re-using session ID", 23))
+      r->offered = 1;
+    else if((size >= 19) && !memcmp(text, "SSL session resumed", 19))
+      r->resumed = 1;
+  }
+  return 0;
+}
+
+static int transfer(char *URL, int num)
+{
+  CURL *curl = NULL;
+  int res = 0;
+  struct resume r;
+
+  memset(&r, 0, sizeof(r));
+
+  easy_init(curl);
+
+  easy_setopt(curl, CURLOPT_URL, URL);
+  easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 0L);
+  easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 0L);
+  easy_setopt(curl, CURLOPT_SSL_SESSION_FILE, libtest_arg2);
+  easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_cb);
+  easy_setopt(curl, CURLOPT_DEBUGDATA, &r);
+  easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+
+  res = curl_easy_perform(curl);
+  if(!res)
+    printf("transfer %d: session offered: %s, resumed: %s\n", num,
+           r.offered ? "yes" : "no", r.resumed ? "yes" : "no");
+
+test_cleanup:
+
+  curl_easy_cleanup(curl);
+
+  return res;
+}
+
+int test(char *URL)
+{
+  int res = 0;
+
+  global_init(CURL_GLOBAL_ALL);
+
+  res = transfer(URL, 1);
+  if(!res)
+    res = transfer(URL, 2);
+
+  curl_global_cleanup();
+
+  return res;
+}
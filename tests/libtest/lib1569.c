@@ -0,0 +1,172 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#ifdef HAVE_UNISTD_H
+#include <unistd.h>
+#endif
+
+#include "testutil.h"
+#include "warnless.h"
+#include "memdebug.h"
+
+#define TEST_HANG_TIMEOUT 60 * 1000
+#define ROUNDS 3
+#define PARALLEL 2
+
+/*
+ * Run a few rounds of parallel transfers on new connections, waiting with
+ * curl_multi_poll(). Where curl_multi_poll() waits on an epoll set, the
+ * sockets of every round are added to it and taken out again when they are
+ * closed. A socket number may then come back in the next round.
+ *
+ * After that, the multi handle has no sockets left. A wakeup must stop the
+ * wait and without one, the wait must last. An extra descriptor that is
+ * readable must be reported as such.
+ */
+int test(char *URL)
+{
+  CURL *easy[PARALLEL];
+  CURLM *multi = NULL;
+  int still_running;
+  int numfds;
+  int round;
+  int i;
+  int res = 0;
+  struct timeval time_before_wait, time_after_wait;
+
+  for(i = 0; i < PARALLEL; i++)
+    easy[i] = NULL;
+
+  start_test_timing();
+
+  global_init(CURL_GLOBAL_ALL);
+
+  multi_init(multi);
+
+  for(round = 0; round < ROUNDS; round++) {
+    for(i = 0; i < PARALLEL; i++) {
+      easy_init(easy[i]);
+      easy_setopt(easy[i], CURLOPT_URL, URL);
+      easy_setopt(easy[i], CURLOPT_FORBID_REUSE, 1L);
+      multi_add_handle(multi, easy[i]);
+    }
+
+    for(;;) {
+      multi_perform(multi, &still_running);
+
+      abort_on_test_timeout();
+
+      if(!still_running)
+        break; /* done */
+
+      multi_poll(multi, NULL, 0, 1000, &numfds);
+
+      abort_on_test_timeout();
+    }
+
+    for(i = 0; i < PARALLEL; i++) {
+      curl_multi_remove_handle(multi, easy[i]);
+      curl_easy_cleanup(easy[i]);
+      easy[i] = NULL;
+    }
+  }
+
+  /* a wakeup ends the wait */
+
+  multi_wakeup(multi);
+
+  time_before_wait = tutil_tvnow();
+  multi_poll(multi, NULL, 0, 1000, &numfds);
+  time_after_wait = tutil_tvnow();
+
+  if(tutil_tvdiff(time_after_wait, time_before_wait) > 500) {
+    fprintf(stderr, "%s:%d curl_multi_poll returned too late\n",
+            __FILE__, __LINE__);
+    res = TEST_ERR_MAJOR_BAD;
+    goto test_cleanup;
+  }
+
+  abort_on_test_timeout();
+
+  /* no socket of the transfers is left to end it */
+
+  time_before_wait = tutil_tvnow();
+  multi_poll(multi, NULL, 0, 1000, &numfds);
+  time_after_wait = tutil_tvnow();
+
+  if(tutil_tvdiff(time_after_wait, time_before_wait) < 500) {
+    fprintf(stderr, "%s:%d curl_multi_poll returned too early\n",
+            __FILE__, __LINE__);
+    res = TEST_ERR_MAJOR_BAD;
+    goto test_cleanup;
+  }
+
+  abort_on_test_timeout();
+
+#if !defined(WIN32) && !defined(_WIN32) && !defined(__WIN32__)
+  {
+    /* an extra descriptor is waited on along with the multi handle's */
+    int fds[2];
+    struct curl_waitfd extra;
+
+    if(pipe(fds)) {
+      fprintf(stderr, "%s:%d pipe() failed\n", __FILE__, __LINE__);
+      res = TEST_ERR_MAJOR_BAD;
+      goto test_cleanup;
+    }
+    if(write(fds[1], "x", 1) != 1) {
+      fprintf(stderr, "%s:%d write() failed\n", __FILE__, __LINE__);
+      res = TEST_ERR_MAJOR_BAD;
+    }
+    else {
+      extra.fd = fds[0];
+      extra.events = CURL_WAIT_POLLIN;
+      extra.revents = 0;
+
+      time_before_wait = tutil_tvnow();
+      res_multi_poll(multi, &extra, 1, 1000, &numfds);
+      time_after_wait = tutil_tvnow();
+
+      if(!res && ((numfds != 1) || !(extra.revents & CURL_WAIT_POLLIN) ||
+                  (tutil_tvdiff(time_after_wait, time_before_wait) > 500))) {
+        fprintf(stderr, "%s:%d extra descriptor not reported\n",
+                __FILE__, __LINE__);
+        res = TEST_ERR_MAJOR_BAD;
+      }
+    }
+    close(fds[0]);
+    close(fds[1]);
+  }
+#endif
+
+test_cleanup:
+
+  for(i = 0; i < PARALLEL; i++) {
+    curl_multi_remove_handle(multi, easy[i]);
+    curl_easy_cleanup(easy[i]);
+  }
+  curl_multi_cleanup(multi);
+  curl_global_cleanup();
+
+  return res;
+}
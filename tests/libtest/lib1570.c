@@ -0,0 +1,102 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#include "memdebug.h"
+
+/*
+ * Download a body many times the size of the receive buffer and count the
+ * body writes in between progress callbacks. Those are made once for every
+ * round of reading from the socket. Unlimited, a round reads again as long
+ * as the reads fill the buffer. With a receive speed limit set, there is a
+ * single read per round.
+ */
+
+struct rounds {
+  int writes; /* writes in the current round */
+  int most;   /* most writes in a single round */
+};
+
+static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userp)
+{
+  struct rounds *r = (struct rounds *)userp;
+  (void)ptr;
+  r->writes++;
+  if(r->writes > r->most)
+    r->most = r->writes;
+  return size * nmemb;
+}
+
+static int xferinfo(void *userp, curl_off_t dltotal, curl_off_t dlnow,
+                    curl_off_t ultotal, curl_off_t ulnow)
+{
+  struct rounds *r = (struct rounds *)userp;
+  (void)dltotal;
+  (void)dlnow;
+  (void)ultotal;
+  (void)ulnow;
+  r->writes = 0;
+  return 0;
+}
+
+int test(char *URL)
+{
+  CURL *curl = NULL;
+  int res = 0;
+  struct rounds r;
+
+  global_init(CURL_GLOBAL_ALL);
+
+  easy_init(curl);
+
+  easy_setopt(curl, CURLOPT_URL, URL);
+  easy_setopt(curl, CURLOPT_BUFFERSIZE, 1024L);
+  easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+  easy_setopt(curl, CURLOPT_WRITEDATA, &r);
+  easy_setopt(curl, CURLOPT_XFERINFOFUNCTION, xferinfo);
+  easy_setopt(curl, CURLOPT_XFERINFODATA, &r);
+  easy_setopt(curl, CURLOPT_NOPROGRESS, 0L);
+
+  memset(&r, 0, sizeof(r));
+  res = curl_easy_perform(curl);
+  if(res)
+    goto test_cleanup;
+  printf("unlimited: more than one read per round: %s\n",
+         (r.most > 1) ? "yes" : "no");
+
+  /* high enough to never slow down this transfer */
+  easy_setopt(curl, CURLOPT_MAX_RECV_SPEED_LARGE,
+              (curl_off_t)1024 * 1024 * 1024);
+
+  memset(&r, 0, sizeof(r));
+  res = curl_easy_perform(curl);
+  if(res)
+    goto test_cleanup;
+  printf("limited: one read per round: %s\n", (r.most == 1) ? "yes" : "no");
+
+test_cleanup:
+
+  curl_easy_cleanup(curl);
+  curl_global_cleanup();
+
+  return res;
+}
@@ -0,0 +1,174 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#include "testutil.h"
+#include "warnless.h"
+#include "memdebug.h"
+
+#define TEST_HANG_TIMEOUT 60 * 1000
+#define CAFILE "log/ca1571"
+
+/*
+ * Do HTTPS transfers on new connections in a single multi handle, verifying
+ * the server against a CA file that the test changes in between:
+ *
+ * 1 - the CA file is a copy of the right CA, the chain gets verified
+ * 2 - same CA file, the chain verified before is re-used
+ * 3 - the CA file grew, the chain is verified again
+ * 4 - the CA file holds another CA, the verification fails
+ *
+ * libtest_arg2 is the right CA, libtest_arg3 another one.
+ */
+
+static int copy_file(const char *from, const char *to, const char *mode)
+{
+  char buf[1024];
+  size_t n;
+  int rc = 0;
+  FILE *in = fopen(from, "rb");
+  FILE *out = fopen(to, mode);
+
+  if(!in || !out)
+    rc = 1;
+  while(!rc && ((n = fread(buf, 1, sizeof(buf), in)) > 0)) {
+    if(fwrite(buf, 1, n, out) != n)
+      rc = 1;
+  }
+  if(in)
+    fclose(in);
+  if(out)
+    fclose(out);
+  return rc;
+}
+
+static int debug_cb(CURL *handle, curl_infotype type, char *text,
+                    size_t size, void *userp)
+{
+  int *reused = (int *)userp;
+  const char *msg = "re-using already verified certificate chain";
+  (void)handle;
+  if((type == CURLINFO_TEXT) && (size >= strlen(msg)) &&
+     !memcmp(text, msg, strlen(msg)))
+    *reused = 1;
+  return 0;
+}
+
+static int transfer(CURLM *multi, char *URL, int num)
+{
+  CURL *curl = NULL;
+  CURLMsg *msg;
+  int still_running;
+  int msgs_left;
+  int numfds;
+  int reused = 0;
+  int res = 0;
+  CURLcode result = CURLE_OK;
+
+  easy_init(curl);
+
+  easy_setopt(curl, CURLOPT_URL, URL);
+  easy_setopt(curl, CURLOPT_CAINFO, CAFILE);
+  /* a new connection with a full handshake every time */
+  easy_setopt(curl, CURLOPT_FORBID_REUSE, 1L);
+  easy_setopt(curl, CURLOPT_SSL_SESSIONID_CACHE, 0L);
+  easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_cb);
+  easy_setopt(curl, CURLOPT_DEBUGDATA, &reused);
+  easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+
+  multi_add_handle(multi, curl);
+
+  for(;;) {
+    multi_perform(multi, &still_running);
+
+    abort_on_test_timeout();
+
+    if(!still_running)
+      break; /* done */
+
+    multi_poll(multi, NULL, 0, 1000, &numfds);
+
+    abort_on_test_timeout();
+  }
+
+  while((msg = curl_multi_info_read(multi, &msgs_left))) {
+    if(msg->msg == CURLMSG_DONE)
+      result = msg->data.result;
+  }
+
+  printf("transfer %d: result %d, chain re-used: %s\n", num, (int)result,
+         reused ? "yes" : "no");
+
+test_cleanup:
+
+  curl_multi_remove_handle(multi, curl);
+  curl_easy_cleanup(curl);
+
+  return res;
+}
+
+int test(char *URL)
+{
+  CURLM *multi = NULL;
+  int res = 0;
+
+  if(!libtest_arg2 || !libtest_arg3) {
+    fprintf(stderr, "Usage: lib1571 [url] [cafile] [othercafile]\n");
+    return TEST_ERR_USAGE;
+  }
+
+  start_test_timing();
+
+  global_init(CURL_GLOBAL_ALL);
+
+  multi_init(multi);
+
+  if(copy_file(libtest_arg2, CAFILE, "wb")) {
+    res = TEST_ERR_MAJOR_BAD;
+    goto test_cleanup;
+  }
+  res = transfer(multi, URL, 1);
+  if(!res)
+    res = transfer(multi, URL, 2);
+
+  if(!res) {
+    /* the same CA twice, a changed CA file all the same */
+    if(copy_file(libtest_arg2, CAFILE, "ab"))
+      res = TEST_ERR_MAJOR_BAD;
+    else
+      res = transfer(multi, URL, 3);
+  }
+
+  if(!res) {
+    if(copy_file(libtest_arg3, CAFILE, "wb"))
+      res = TEST_ERR_MAJOR_BAD;
+    else
+      res = transfer(multi, URL, 4);
+  }
+
+test_cleanup:
+
+  curl_multi_cleanup(multi);
+  curl_global_cleanup();
+
+  return res;
+}
@@ -0,0 +1,149 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#include "testutil.h"
+#include "warnless.h"
+#include "memdebug.h"
+
+#define TEST_HANG_TIMEOUT 60 * 1000
+
+/*
+ * Two transfers multiplexed over one HTTP/2 connection. The write callback
+ * of the first one pauses it after the first piece of the body. Only then the
+ * second one is started, and the first one is unpaused once the second one
+ * is done. The paused stream must not hold up the other one.
+ */
+
+struct transfer {
+  CURL *easy;
+  size_t bytes;  /* body bytes written */
+  int pause;     /* pause at the next write after the first one */
+  int paused;
+  int started;
+  int done;
+};
+
+static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userp)
+{
+  struct transfer *t = (struct transfer *)userp;
+  (void)ptr;
+  if(t->pause && t->bytes) {
+    t->pause = 0;
+    t->paused = 1;
+    return CURL_WRITEFUNC_PAUSE;
+  }
+  t->bytes += size * nmemb;
+  return size * nmemb;
+}
+
+int test(char *URL)
+{
+  struct transfer t[2];
+  CURLM *multi = NULL;
+  int still_running;
+  int numfds;
+  int msgs;
+  int i;
+  int res = 0;
+
+  memset(t, 0, sizeof(t));
+
+  start_test_timing();
+
+  global_init(CURL_GLOBAL_ALL);
+
+  multi_init(multi);
+
+  for(i = 0; i < 2; i++) {
+    easy_init(t[i].easy);
+    easy_setopt(t[i].easy, CURLOPT_URL, URL);
+    easy_setopt(t[i].easy, CURLOPT_HTTP_VERSION,
+                (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+    easy_setopt(t[i].easy, CURLOPT_PIPEWAIT, 1L);
+    easy_setopt(t[i].easy, CURLOPT_WRITEFUNCTION, write_cb);
+    easy_setopt(t[i].easy, CURLOPT_WRITEDATA, &t[i]);
+  }
+  t[0].pause = 1;
+  multi_add_handle(multi, t[0].easy);
+
+  multi_setopt(multi, CURLMOPT_PIPELINING, CURLPIPE_MULTIPLEX);
+
+  for(;;) {
+    CURLMsg *msg;
+
+    multi_perform(multi, &still_running);
+
+    abort_on_test_timeout();
+
+    while((msg = curl_multi_info_read(multi, &msgs)) != NULL) {
+      if(msg->msg != CURLMSG_DONE)
+        continue;
+      for(i = 0; i < 2; i++) {
+        if(msg->easy_handle == t[i].easy) {
+          t[i].done = 1;
+          if(msg->data.result) {
+            fprintf(stderr, "transfer %d failed: %d\n", i + 1,
+                    (int)msg->data.result);
+            res = (int)msg->data.result;
+          }
+        }
+      }
+    }
+    if(res)
+      break;
+
+    if(t[0].paused && !t[1].started) {
+      t[1].started = 1;
+      multi_add_handle(multi, t[1].easy);
+      continue;
+    }
+
+    if(t[1].done && t[0].paused) {
+      printf("second transfer done while the first is paused\n");
+      t[0].paused = 0;
+      curl_easy_pause(t[0].easy, CURLPAUSE_CONT);
+      continue;
+    }
+
+    if(!still_running)
+      break; /* done */
+
+    multi_poll(multi, NULL, 0, 1000, &numfds);
+
+    abort_on_test_timeout();
+  }
+
+  for(i = 0; i < 2; i++)
+    printf("transfer %d: %ld bytes\n", i + 1, (long)t[i].bytes);
+
+test_cleanup:
+
+  for(i = 0; i < 2; i++) {
+    curl_multi_remove_handle(multi, t[i].easy);
+    curl_easy_cleanup(t[i].easy);
+  }
+  curl_multi_cleanup(multi);
+  curl_global_cleanup();
+
+  return res;
+}
@@ -0,0 +1,165 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "test.h"
+
+#include "testutil.h"
+#include "warnless.h"
+#include "memdebug.h"
+
+#define TEST_HANG_TIMEOUT 60 * 1000
+
+/*
+ * Get the page at URL over HTTP/2 with CURLMOPT_MAX_CACHED_PUSHES set to
+ * the second argument, then each of the URLs in the arguments after that,
+ * one at a time on the same connection. A URL can be followed by
+ * ",name:value" to send that header with it. Tells for every request
+ * whether it was served from a push kept from the page.
+ */
+
+struct result {
+  int pushed;   /* served from a kept push */
+  long bytes;   /* body bytes written */
+};
+
+static int debug_cb(CURL *handle, curl_infotype type, char *text,
+                    size_t size, void *userp)
+{
+  struct result *r = (struct result *)userp;
+  (void)handle;
+  if((type == CURLINFO_TEXT) && (size >= 21) &&
+     !memcmp(text, "Using pushed response", 21))
+    r->pushed = 1;
+  return 0;
+}
+
+static size_t write_cb(void *ptr, size_t size, size_t nmemb, void *userp)
+{
+  struct result *r = (struct result *)userp;
+  (void)ptr;
+  r->bytes += (long)(size * nmemb);
+  return size * nmemb;
+}
+
+static int get(CURLM *multi, char *url, int num)
+{
+  CURL *curl = NULL;
+  struct curl_slist *headers = NULL;
+  struct result r;
+  char *header;
+  int still_running;
+  int numfds;
+  int msgs;
+  int res = 0;
+
+  memset(&r, 0, sizeof(r));
+
+  header = strchr(url, ',');
+  if(header)
+    *header++ = 0;
+
+  easy_init(curl);
+
+  easy_setopt(curl, CURLOPT_URL, url);
+  easy_setopt(curl, CURLOPT_HTTP_VERSION,
+              (long)CURL_HTTP_VERSION_2_PRIOR_KNOWLEDGE);
+  easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
+  easy_setopt(curl, CURLOPT_WRITEDATA, &r);
+  easy_setopt(curl, CURLOPT_DEBUGFUNCTION, debug_cb);
+  easy_setopt(curl, CURLOPT_DEBUGDATA, &r);
+  easy_setopt(curl, CURLOPT_VERBOSE, 1L);
+  if(header) {
+    headers = curl_slist_append(NULL, header);
+    if(!headers) {
+      res = TEST_ERR_MAJOR_BAD;
+      goto test_cleanup;
+    }
+    easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
+  }
+
+  multi_add_handle(multi, curl);
+
+  for(;;) {
+    CURLMsg *msg;
+
+    multi_perform(multi, &still_running);
+
+    abort_on_test_timeout();
+
+    while((msg = curl_multi_info_read(multi, &msgs)) != NULL) {
+      if((msg->msg == CURLMSG_DONE) && msg->data.result) {
+        fprintf(stderr, "request %d failed: %d\n", num,
+                (int)msg->data.result);
+        res = (int)msg->data.result;
+      }
+    }
+
+    if(!still_running || res)
+      break;
+
+    multi_poll(multi, NULL, 0, 1000, &numfds);
+
+    abort_on_test_timeout();
+  }
+
+  if(!res)
+    printf("request %d: pushed: %s, %ld bytes\n", num,
+           r.pushed ? "yes" : "no", r.bytes);
+
+test_cleanup:
+
+  curl_multi_remove_handle(multi, curl);
+  curl_easy_cleanup(curl);
+  curl_slist_free_all(headers);
+
+  return res;
+}
+
+int test(char *URL)
+{
+  CURLM *multi = NULL;
+  int res = 0;
+  int i;
+
+  if(test_argc < 3) {
+    fprintf(stderr, "%s:%d too few arguments\n", __FILE__, __LINE__);
+    return TEST_ERR_MAJOR_BAD;
+  }
+
+  start_test_timing();
+
+  global_init(CURL_GLOBAL_ALL);
+
+  multi_init(multi);
+
+  multi_setopt(multi, CURLMOPT_MAX_CACHED_PUSHES, atol(libtest_arg2));
+
+  res = get(multi, URL, 0);
+  for(i = 3; !res && (i < test_argc); i++)
+    res = get(multi, test_argv[i], i - 2);
+
+test_cleanup:
+
+  curl_multi_cleanup(multi);
+  curl_global_cleanup();
+
+  return res;
+}
@@ -0,0 +1,150 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "curlcheck.h"
+
+#include "urldata.h"
+#include "conncache.h"
+#include "curl_addrinfo.h"
+
+#include "memdebug.h" /* LAST include file */
+
+#ifdef USE_NGHTTP2
+
+bool coalesce_match(struct connectdata *check,
+                    struct connectdata *needle,
+                    struct Curl_multi *multi,
+                    const Curl_addrinfo *addr);
+
+static struct Curl_handler https;
+static struct Curl_handler http;
+static struct connectbundle bundle;
+static struct connectdata check;
+static struct connectdata needle;
+static Curl_addrinfo *addr;
+
+static CURLcode unit_setup(void)
+{
+  https.protocol = CURLPROTO_HTTPS;
+  http.protocol = CURLPROTO_HTTP;
+  bundle.multiuse = BUNDLE_MULTIPLEX;
+
+  addr = Curl_str2addr((char *)"10.0.0.1", 443);
+  if(!addr)
+    return CURLE_OUT_OF_MEMORY;
+  return CURLE_OK;
+}
+
+static void unit_stop(void)
+{
+  Curl_freeaddrinfo(addr);
+}
+
+/* an HTTP/2 connection to 10.0.0.1 with one stream going on */
+static void reset(void)
+{
+  memset(&check, 0, sizeof(check));
+  check.handler = &https;
+  check.remote_port = 443;
+  check.bits.multiplex = TRUE;
+  check.bundle = &bundle;
+  check.easyq.size = 1;
+  check.proto.httpc.settings.max_concurrent_streams = 100;
+  strcpy(check.primary_ip, "10.0.0.1");
+
+  memset(&needle, 0, sizeof(needle));
+  needle.handler = &https;
+  needle.remote_port = 443;
+}
+
+UNITTEST_START
+{
+  reset();
+  fail_unless(coalesce_match(&check, &needle, NULL, addr),
+              "connection in use is not taken");
+
+  reset();
+  check.easyq.size = 0;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "idle connection is taken");
+
+  reset();
+  check.bits.multiplex = FALSE;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "HTTP/1 connection is taken");
+
+  reset();
+  check.bits.close = TRUE;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection marked for close is taken");
+
+  reset();
+  needle.handler = &http;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection for another protocol is taken");
+
+  reset();
+  needle.remote_port = 8443;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection to another port is taken");
+
+  reset();
+  check.bits.httpproxy = TRUE;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection through a proxy is taken");
+
+  reset();
+  check.bits.conn_to_host = TRUE;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection made with CURLOPT_CONNECT_TO is taken");
+
+  reset();
+  check.proto.httpc.settings.max_concurrent_streams = 1;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection without free streams is taken");
+
+  reset();
+  needle.ssl_config.verifystatus = TRUE;
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection with other TLS options is taken");
+
+  reset();
+  strcpy(check.primary_ip, "10.0.0.2");
+  fail_if(coalesce_match(&check, &needle, NULL, addr),
+          "connection to another address is taken");
+}
+UNITTEST_STOP
+
+#else /* USE_NGHTTP2 */
+
+static CURLcode unit_setup(void)
+{
+  return CURLE_OK;
+}
+
+static void unit_stop(void)
+{
+}
+
+UNITTEST_START
+UNITTEST_STOP
+
+#endif
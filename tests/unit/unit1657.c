@@ -0,0 +1,128 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "curlcheck.h"
+
+#include "urldata.h"
+
+#include "memdebug.h" /* LAST include file */
+
+#ifdef USE_NGHTTP2
+
+bool h2_bdp_window(struct http_conn *httpc, size_t sample, size_t rate);
+
+#define MB (1024 * 1024)
+
+static struct http_conn httpc;
+
+static CURLcode unit_setup(void)
+{
+  return CURLE_OK;
+}
+
+static void unit_stop(void)
+{
+}
+
+/* a connection that has not resized its windows yet */
+static void reset(void)
+{
+  memset(&httpc, 0, sizeof(httpc));
+  httpc.window = MB;
+  httpc.stream_window = MB;
+}
+
+UNITTEST_START
+{
+  int i;
+
+  reset();
+  fail_unless(h2_bdp_window(&httpc, 800 * 1024, 1000),
+              "a sample filling the window does not grow it");
+  fail_unless(httpc.window == 1600 * 1024, "window is not twice the sample");
+  fail_unless(httpc.stream_window == 1600 * 1024,
+              "stream window does not follow");
+
+  fail_if(h2_bdp_window(&httpc, 1500 * 1024, 900),
+          "window grows although the rate went down");
+  fail_unless(httpc.window == 1600 * 1024, "window changed");
+
+  reset();
+  for(i = 0; i < 10; i++)
+    h2_bdp_window(&httpc, httpc.window, 1000 + i);
+  fail_unless(httpc.window == 32 * MB, "window is not capped at 32MB");
+  fail_unless(httpc.stream_window == 8 * MB,
+              "stream window is not capped at 8MB");
+
+  /* shrinks only after three low samples in a row */
+  fail_if(h2_bdp_window(&httpc, 2 * MB, 10),
+          "window shrinks after one low sample");
+  fail_if(h2_bdp_window(&httpc, 3 * MB, 10),
+          "window shrinks after two low samples");
+  fail_unless(h2_bdp_window(&httpc, 1 * MB, 10),
+              "window does not shrink after three low samples");
+  fail_unless(httpc.window == 6 * MB,
+              "window is not twice the largest low sample");
+  fail_unless(httpc.stream_window == 6 * MB,
+              "stream window does not follow");
+
+  /* the lower rate now counts as the one to beat */
+  fail_unless(h2_bdp_window(&httpc, 5 * MB, 10),
+              "window does not grow again after shrinking");
+  fail_unless(httpc.window == 10 * MB, "window is not twice the sample");
+  fail_unless(httpc.stream_window == 8 * MB,
+              "stream window is not capped at 8MB");
+
+  /* a sample in between starts the count over */
+  h2_bdp_window(&httpc, 1 * MB, 10);
+  h2_bdp_window(&httpc, 1 * MB, 10);
+  fail_if(h2_bdp_window(&httpc, 5 * MB, 10),
+          "a sample using half the window changes it");
+  h2_bdp_window(&httpc, 1 * MB, 10);
+  fail_if(h2_bdp_window(&httpc, 1 * MB, 10),
+          "window shrinks after two low samples in a row");
+  fail_unless(h2_bdp_window(&httpc, 0, 10),
+              "window does not shrink after three low samples");
+  fail_unless(httpc.window == 2 * MB, "window did not shrink to 2MB");
+
+  /* never below where it started */
+  for(i = 0; i < 6; i++)
+    h2_bdp_window(&httpc, 0, 0);
+  fail_unless(httpc.window == MB, "window shrinks below 1MB");
+  fail_unless(httpc.stream_window == MB, "stream window shrinks below 1MB");
+}
+UNITTEST_STOP
+
+#else /* USE_NGHTTP2 */
+
+static CURLcode unit_setup(void)
+{
+  return CURLE_OK;
+}
+
+static void unit_stop(void)
+{
+}
+
+UNITTEST_START
+UNITTEST_STOP
+
+#endif
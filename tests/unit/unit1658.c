@@ -0,0 +1,102 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "curlcheck.h"
+
+#include "urldata.h"
+
+#include "memdebug.h" /* LAST include file */
+
+#ifdef USE_NGHTTP2
+
+void h2_inbuf_size(struct http_conn *httpc, size_t len, size_t max);
+
+#define KB 1024
+
+static struct http_conn httpc;
+
+static CURLcode unit_setup(void)
+{
+  return CURLE_OK;
+}
+
+static void unit_stop(void)
+{
+}
+
+/* a connection buffer of 'size' bytes */
+static void reset(size_t size)
+{
+  memset(&httpc, 0, sizeof(httpc));
+  httpc.inbufsize = size;
+  httpc.inbufwant = size;
+}
+
+UNITTEST_START
+{
+  reset(32 * KB);
+  h2_inbuf_size(&httpc, 32 * KB, 512 * KB);
+  fail_unless(httpc.inbuf_filled, "full read is not flagged");
+  fail_unless(httpc.inbufwant == 64 * KB, "buffer does not grow");
+
+  reset(512 * KB);
+  h2_inbuf_size(&httpc, 512 * KB, 512 * KB);
+  fail_unless(httpc.inbuf_filled, "full read is not flagged");
+  fail_unless(httpc.inbufwant == 512 * KB, "buffer grows past the max");
+
+  reset(64 * KB);
+  h2_inbuf_size(&httpc, 64 * KB, 100 * KB);
+  fail_unless(httpc.inbufwant == 100 * KB,
+              "buffer does not stop at a max that is not a power of two");
+
+  reset(64 * KB);
+  h2_inbuf_size(&httpc, 20 * KB, 512 * KB);
+  fail_if(httpc.inbuf_filled, "short read is flagged as full");
+  fail_unless(httpc.inbufwant == 64 * KB,
+              "buffer changes after using more than a quarter of it");
+
+  reset(64 * KB);
+  h2_inbuf_size(&httpc, 10 * KB, 512 * KB);
+  fail_if(httpc.inbuf_filled, "short read is flagged as full");
+  fail_unless(httpc.inbufwant == 32 * KB, "buffer does not shrink");
+
+  reset(32 * KB);
+  h2_inbuf_size(&httpc, 1, 512 * KB);
+  fail_unless(httpc.inbufwant == 32 * KB,
+              "buffer shrinks below where it started");
+}
+UNITTEST_STOP
+
+#else /* USE_NGHTTP2 */
+
+static CURLcode unit_setup(void)
+{
+  return CURLE_OK;
+}
+
+static void unit_stop(void)
+{
+}
+
+UNITTEST_START
+UNITTEST_STOP
+
+#endif
@@ -0,0 +1,131 @@
+/***************************************************************************
+ *                                  _   _ ____  _
+ *  Project                     ___| | | |  _ \| |
+ *                             / __| | | | |_) | |
+ *                            | (__| |_| |  _ <| |___
+ *                             \___|\___/|_| \_\_____|
+ *
+ * Copyright (C) 1998 - 2019, Daniel Stenberg, <daniel@haxx.se>, et al.
+ *
+ * This software is licensed as described in the file COPYING, which
+ * you should have received as part of this distribution. The terms
+ * are also available at https://curl.haxx.se/docs/copyright.html.
+ *
+ * You may opt to use, copy, modify, merge, publish, distribute and/or sell
+ * copies of the Software, and permit persons to whom the Software is
+ * furnished to do so, under the terms of the COPYING file.
+ *
+ * This software is distributed on an "AS IS" basis, WITHOUT WARRANTY OF ANY
+ * KIND, either express or implied.
+ *
+ ***************************************************************************/
+#include "curlcheck.h"
+
+#include "urldata.h"
+#include "url.h"
+#include "connect.h"
+#include "conncache.h"
+#include "multiif.h"
+#include "multihandle.h"
+
+#include "memdebug.h" /* LAST include file */
+
+static CURLM *multi;
+static CURL *easy;
+static CURL *closer;
+
+static CURLcode unit_setup(void)
+{
+  int res = CURLE_OK;
+
+  global_init(CURL_GLOBAL_ALL);
+  multi = curl_multi_init();
+  if(!multi) {
+    curl_global_cleanup();
+    return CURLE_OUT_OF_MEMORY;
+  }
+  return res;
+}
+
+static void unit_stop(void)
+{
+  if(easy) {
+    curl_multi_remove_handle(multi, easy);
+    curl_easy_cleanup(easy);
+  }
+  if(closer) {
+    curl_multi_remove_handle(multi, closer);
+    curl_easy_cleanup(closer);
+  }
+  curl_multi_cleanup(multi);
+  curl_global_cleanup();
+}
+
+UNITTEST_START
+{
+  char *buf[MAX_POOLED_BUFFERS + 2];
+  char *a;
+  char *b;
+  size_t i;
+  int running = 1;
+  int loops = 0;
+  struct connectdata *conn;
+
+  /* a buffer given back is lent again, for the same size only */
+  a = Curl_multi_getbuffer(multi, 1000);
+  fail_unless(a, "no buffer lent");
+  abort_unless(a, "out of memory");
+  Curl_multi_putbuffer(multi, a, 1000);
+  fail_unless(multi->num_buffers == 1, "buffer not kept in the pool");
+  b = Curl_multi_getbuffer(multi, 2000);
+  fail_unless(b && (b != a), "buffer lent for another size");
+  fail_unless(multi->num_buffers == 1, "pool changed for another size");
+  free(b);
+  b = Curl_multi_getbuffer(multi, 1000);
+  fail_unless(b == a, "buffer in the pool not reused");
+  fail_unless(!multi->num_buffers, "reused buffer still in the pool");
+  free(b);
+
+  /* the pool doesn't grow without limit */
+  for(i = 0; i < sizeof(buf)/sizeof(buf[0]); i++)
+    buf[i] = Curl_multi_getbuffer(multi, 500);
+  for(i = 0; i < sizeof(buf)/sizeof(buf[0]); i++)
+    Curl_multi_putbuffer(multi, buf[i], 500);
+  fail_unless(multi->num_buffers == MAX_POOLED_BUFFERS,
+              "pool not limited");
+
+  /* empty the pool for what follows */
+  while(multi->num_buffers)
+    free(Curl_multi_getbuffer(multi, 500));
+
+  /* do an FTP transfer, which leaves its connection in the cache */
+  easy = curl_easy_init();
+  abort_unless(easy, "out of memory");
+  curl_easy_setopt(easy, CURLOPT_URL, arg);
+  curl_multi_add_handle(multi, easy);
+  while(running && (loops++ < 1000)) {
+    curl_multi_perform(multi, &running);
+    if(running)
+      curl_multi_wait(multi, NULL, 0, 100, NULL);
+  }
+  fail_unless(!running, "transfer not done");
+  curl_multi_remove_handle(multi, easy);
+  curl_easy_cleanup(easy);
+  easy = NULL;
+
+  /* close it with a transfer that never read anything, so has no receive
+     buffer of its own for the QUIT exchange */
+  closer = curl_easy_init();
+  abort_unless(closer, "out of memory");
+  curl_multi_add_handle(multi, closer);
+  fail_unless(!closer->state.buffer, "closing transfer has a buffer");
+  conn = Curl_conncache_extract_oldest(closer);
+  abort_unless(conn, "connection not kept");
+  conn->data = closer;
+  connclose(conn, "unit test");
+  Curl_disconnect(closer, conn, FALSE);
+
+  fail_unless(!closer->state.buffer, "buffer not given back");
+  fail_unless(multi->num_buffers == 1, "buffer not returned to the pool");
+}
+UNITTEST_STOP